@@ -25,21 +25,638 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "esp_microsleep.h"
+#include "esp_microsleep_private.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_timer.h"
 #include "rom/ets_sys.h"
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+#include "esp_cpu.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 #if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
 
-static uint64_t esp_microsleep_compensation = 0;
+/**
+ * @brief Per-task context.
+ *
+ * Allocated on the first delay of a task, unless the task provides the storage itself,
+ * see `esp_microsleep_ctx_register`.
+ */
+typedef struct esp_microsleep_task {
+    struct esp_microsleep_task* next;  // all task contexts, see esp_microsleep_get_task_stats
+    struct esp_microsleep_task* next_sleeper;
+    esp_microsleep_domain_handle_t domain;
+    esp_timer_handle_t timer;          // ESP_MICROSLEEP_BACKEND_TASK_TIMER: wakes up the task at the end of a delay
+    uint64_t expiry;                   // when the timer is due
+    TaskHandle_t task;
+    char name[configMAX_TASK_NAME_LEN];
+    bool caller_owned;                 // registered with esp_microsleep_ctx_register, not to be freed
+    portMUX_TYPE lock;                 // guards the boost state against the restore timer, and the 64-bit counters
+    UBaseType_t boost_priority;        // per-task boost priority, 0 = disabled
+    uint64_t boost_hold_us;            // how long a boost outlives the wakeup, 0 = until the next delay
+    UBaseType_t base_priority;         // priority to restore, valid while boosted
+    UBaseType_t boosted_priority;      // priority applied by the boost, valid while boosted
+    bool boosted;
+    bool restore_armed;
+    bool restoring;
+    bool restore_waiting;              // the task waits on restored_sem for the restore callback
+    esp_timer_handle_t restore_timer;  // created on first boost
+    SemaphoreHandle_t restored_sem;    // given by the restore callback when the task waits for it
+    StaticSemaphore_t restored_sem_buffer;
+    bool selecting;                    // the timer wakes up esp_microsleep_select instead of a delay
+    SemaphoreHandle_t select_sem;      // member of select_set, given by the timer
+    StaticSemaphore_t select_sem_buffer;
+    QueueSetHandle_t select_set;
+    uint64_t deadlines[CONFIG_ESP_MICROSLEEP_DEADLINE_DEPTH];  // deadline scopes, innermost last
+    uint8_t deadline_depth;
+    esp_microsleep_compensation_t compensation;  // latency history for the compensation policies
+    uint32_t latency_avg16;            // moving average of the timer wakeup latency, in 1/16 µs
+    uint32_t latency_dev16;            // moving mean deviation of the timer wakeup latency, in 1/16 µs
+    uint32_t warmup_avg16;             // moving average of the warm-up hook duration, in 1/16 µs
+    bool sla_enabled;
+    esp_microsleep_sla_t sla;
+    uint32_t calls;                    // accounting, see esp_microsleep_task_stats_t
+    uint32_t wakeups;
+    uint64_t spin_us;
+    uint64_t sleep_us;
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+    BaseType_t core;                   // core the task went to sleep on
+    TaskHandle_t culprit;              // set at interrupt time: the interrupted task, if the interrupt was late,
+                                       // otherwise the task running on the sleeper's core
+    bool culprit_irq_masked;
+    char culprit_name[configMAX_TASK_NAME_LEN];  // copied at interrupt time, the culprit may be gone by the wakeup
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_ALERTS
+    esp_microsleep_alert_streak_t alert_streaks[CONFIG_ESP_MICROSLEEP_ALERTS_MAX];  // consecutive late delays per alert
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_TRACE
+    uint16_t trace_id;                 // see esp_microsleep_trace_record
+    uint16_t trace_generation;
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_BURST_DETECTION
+    uint64_t last_return;              // end of the previous delay
+    uint32_t burst_calls;              // consecutive delays with short gaps in between
+#endif
+} esp_microsleep_task_t;
+
+_Static_assert(sizeof(esp_microsleep_ctx_t) == sizeof(esp_microsleep_task_t), "esp_microsleep_ctx_t does not match esp_microsleep_task_t");
+_Static_assert(_Alignof(esp_microsleep_ctx_t) == _Alignof(esp_microsleep_task_t), "esp_microsleep_ctx_t does not match esp_microsleep_task_t");
+
+struct esp_microsleep_domain {
+    struct esp_microsleep_domain* next;       // all domains, see esp_microsleep_domain_find
+    char name[CONFIG_ESP_MICROSLEEP_DOMAIN_NAME_LEN];
+    esp_microsleep_backend_t backend;
+    uint64_t compensation;                    // as calibrated
+    esp_microsleep_config_t config;
+    portMUX_TYPE config_lock;
+    esp_microsleep_stats_t stats;
+    esp_timer_handle_t timer;                 // ESP_MICROSLEEP_BACKEND_SHARED_TIMER: wakes up the first sleeper
+    esp_microsleep_task_t* sleepers;          // ESP_MICROSLEEP_BACKEND_SHARED_TIMER: sleeping tasks, ordered by expiry
+    portMUX_TYPE sleepers_lock;
+};
+
+static const esp_microsleep_config_t esp_microsleep_default_config = {
+#ifdef CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN
+    .mode = ESP_MICROSLEEP_STRATEGY_HYBRID,
+#else
+    .mode = ESP_MICROSLEEP_STRATEGY_SLEEP,
+#endif
+    .stats_enabled = true,
+};
+static struct esp_microsleep_domain esp_microsleep_default_domain = {
+    .name = "default",
+    .backend = ESP_MICROSLEEP_BACKEND_TASK_TIMER,
+    .config = esp_microsleep_default_config,
+    .config_lock = portMUX_INITIALIZER_UNLOCKED,
+    .sleepers_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+static esp_microsleep_domain_handle_t esp_microsleep_domains = &esp_microsleep_default_domain;
+static portMUX_TYPE esp_microsleep_domains_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_microsleep_task_t* esp_microsleep_tasks = NULL;
+static portMUX_TYPE esp_microsleep_tasks_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+static esp_microsleep_culprit_t esp_microsleep_culprits[CONFIG_ESP_MICROSLEEP_CULPRITS_MAX];
+static portMUX_TYPE esp_microsleep_culprits_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+static inline esp_microsleep_domain_handle_t esp_microsleep_domain_or_default(esp_microsleep_domain_handle_t domain) {
+    return domain ? domain : &esp_microsleep_default_domain;
+}
+
+static inline void IRAM_ATTR esp_microsleep_count(esp_microsleep_domain_handle_t domain, uint32_t* counter) {
+    if (!domain->config.stats_enabled) { return; }
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+// The 64-bit time counters of a task are updated under its lock, so readers on the other core never see a torn value.
+static inline void esp_microsleep_account(esp_microsleep_task_t* ctx, uint64_t* counter, uint64_t us) {
+    if (!ctx->domain->config.stats_enabled) { return; }
+    portENTER_CRITICAL(&ctx->lock);
+    *counter += us;
+    portEXIT_CRITICAL(&ctx->lock);
+}
+
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+// Picks the task to blame, should the wakeup turn out late. Done at interrupt time, when the
+// culprit is known to exist: if the interrupt itself was late, the task it interrupted masked it.
+static void IRAM_ATTR esp_microsleep_suspect_from_isr(esp_microsleep_task_t* ctx) {
+
+    const int64_t isr_latency = (int64_t)(esp_timer_get_time() - ctx->expiry);
+    ctx->culprit_irq_masked = isr_latency > CONFIG_ESP_MICROSLEEP_CULPRIT_IRQ_LATENCY_US;
+    ctx->culprit = ctx->culprit_irq_masked ? xTaskGetCurrentTaskHandle() : xTaskGetCurrentTaskHandleForCore(ctx->core);
+    const char* name = ctx->culprit ? pcTaskGetName(ctx->culprit) : "";
+    size_t i = 0;
+    for (; i < sizeof(ctx->culprit_name) - 1 && name[i]; i++) { ctx->culprit_name[i] = name[i]; }
+    ctx->culprit_name[i] = '\0';
+}
+#endif
+
+static void IRAM_ATTR esp_microsleep_wake_from_isr(esp_microsleep_task_t* ctx, BaseType_t* higherPriorityTaskWoken) {
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+    esp_microsleep_suspect_from_isr(ctx);
+#endif
+    if (ctx->selecting) {
+        xSemaphoreGiveFromISR(ctx->select_sem, higherPriorityTaskWoken);
+    } else {
+        vTaskNotifyGiveFromISR(ctx->task, higherPriorityTaskWoken);
+    }
+    esp_microsleep_count(ctx->domain, &ctx->domain->stats.wakeups);
+    esp_microsleep_count(ctx->domain, &ctx->wakeups);
+}
+
+static void IRAM_ATTR esp_microsleep_yield_from_isr(esp_microsleep_domain_handle_t domain, BaseType_t higherPriorityTaskWoken) {
+    // Only preempt the running task, if the sleeper outranks it.
+    if (higherPriorityTaskWoken == pdTRUE) {
+        esp_microsleep_count(domain, &domain->stats.wakeup_yields);
+        esp_timer_isr_dispatch_need_yield();
+    }
+}
 
 static void IRAM_ATTR esp_microsleep_isr_handler(void* arg) {
-    TaskHandle_t task = (TaskHandle_t)(arg);
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+    const uint32_t isr_start = esp_cpu_get_cycle_count();
+#endif
+    esp_microsleep_task_t* ctx = (esp_microsleep_task_t*)(arg);
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    esp_microsleep_wake_from_isr(ctx, &higherPriorityTaskWoken);
+    esp_microsleep_yield_from_isr(ctx->domain, higherPriorityTaskWoken);
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+    esp_microsleep_bench_isr(esp_cpu_get_cycle_count() - isr_start);
+#endif
+}
+
+static void IRAM_ATTR esp_microsleep_shared_isr_handler(void* arg) {
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+    const uint32_t isr_start = esp_cpu_get_cycle_count();
+#endif
+    esp_microsleep_domain_handle_t domain = (esp_microsleep_domain_handle_t)(arg);
+
+    // Take all due sleepers off the list and re-arm the timer for the next one.
+    portENTER_CRITICAL_ISR(&domain->sleepers_lock);
+    const uint64_t now = esp_timer_get_time();
+    esp_microsleep_task_t* due = domain->sleepers;
+    esp_microsleep_task_t** tail = &domain->sleepers;
+    while (*tail && (*tail)->expiry <= now) { tail = &(*tail)->next_sleeper; }
+    domain->sleepers = *tail;
+    *tail = NULL;
+    if (domain->sleepers) {
+        esp_timer_stop(domain->timer);
+        esp_timer_start_once(domain->timer, domain->sleepers->expiry - now);
+    }
+    portEXIT_CRITICAL_ISR(&domain->sleepers_lock);
+
     BaseType_t higherPriorityTaskWoken = pdFALSE;
-    vTaskNotifyGiveFromISR(task, &higherPriorityTaskWoken);
-    esp_timer_isr_dispatch_need_yield();
+    while (due) {
+        esp_microsleep_task_t* ctx = due;
+        due = ctx->next_sleeper;
+        esp_microsleep_wake_from_isr(ctx, &higherPriorityTaskWoken);
+    }
+    esp_microsleep_yield_from_isr(domain, higherPriorityTaskWoken);
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+    esp_microsleep_bench_isr(esp_cpu_get_cycle_count() - isr_start);
+#endif
+}
+
+#ifdef CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN
+static void IRAM_ATTR esp_microsleep_critical_spin_until(esp_microsleep_domain_handle_t domain, uint64_t deadline) {
+
+    uint64_t now = esp_timer_get_time();
+    if (now >= deadline) {
+        esp_microsleep_count(domain, &domain->stats.critical_spin_late);
+        return;
+    }
+    if (deadline - now > CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN_MAX_US) {
+        // Woke up too early to mask interrupts for the whole rest, spin the excess with interrupts enabled.
+        esp_microsleep_count(domain, &domain->stats.critical_spin_cap_hits);
+        ets_delay_us(deadline - now - CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN_MAX_US);
+    }
+    // Mask interrupts on this core only, a shared lock would make tasks on the other core spin for it.
+    const UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    now = esp_timer_get_time();
+    if (now < deadline) { ets_delay_us(deadline - now); }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+    esp_microsleep_count(domain, &domain->stats.critical_spins);
+}
+#endif
+
+void esp_microsleep_domain_get_stats(esp_microsleep_domain_handle_t domain, esp_microsleep_stats_t* stats) {
+
+    *stats = esp_microsleep_domain_or_default(domain)->stats;
+}
+
+void esp_microsleep_domain_reset_stats(esp_microsleep_domain_handle_t domain) {
+
+    domain = esp_microsleep_domain_or_default(domain);
+    memset(&domain->stats, 0, sizeof(domain->stats));
+}
+
+void esp_microsleep_get_stats(esp_microsleep_stats_t* stats) {
+
+    esp_microsleep_domain_get_stats(NULL, stats);
+}
+
+void esp_microsleep_reset_stats() {
+
+    esp_microsleep_domain_reset_stats(NULL);
+}
+
+#if CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS
+static void esp_microsleep_task_deleted(int index, void* pvTLS) {
+
+    esp_microsleep_task_t* ctx = (esp_microsleep_task_t*) pvTLS;
+
+    portENTER_CRITICAL(&esp_microsleep_tasks_lock);
+    for (esp_microsleep_task_t** link = &esp_microsleep_tasks; *link; link = &(*link)->next) {
+        if (*link == ctx) {
+            *link = ctx->next;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_microsleep_tasks_lock);
+
+    // The task might have been deleted while sleeping on a shared timer.
+    esp_microsleep_domain_handle_t domain = ctx->domain;
+    portENTER_CRITICAL(&domain->sleepers_lock);
+    for (esp_microsleep_task_t** link = &domain->sleepers; *link; link = &(*link)->next_sleeper) {
+        if (*link == ctx) {
+            *link = ctx->next_sleeper;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&domain->sleepers_lock);
+
+    if (ctx->timer) {
+        esp_timer_stop(ctx->timer);
+        esp_timer_delete(ctx->timer);
+    }
+    if (ctx->restore_timer) {
+        esp_timer_stop(ctx->restore_timer);
+        esp_timer_delete(ctx->restore_timer);
+        vSemaphoreDelete(ctx->restored_sem);
+    }
+    if (ctx->select_sem) {
+        xSemaphoreTake(ctx->select_sem, 0);
+        xQueueRemoveFromSet(ctx->select_sem, ctx->select_set);
+        vSemaphoreDelete(ctx->select_sem);
+    }
+    if (!ctx->caller_owned) {
+        free(ctx);
+    }
+}
+#endif
+
+// Initializes a zeroed context for the current task and makes it known.
+static void esp_microsleep_attach(esp_microsleep_task_t* ctx, esp_microsleep_domain_handle_t domain) {
+
+    ctx->task = xTaskGetCurrentTaskHandle();
+    strlcpy(ctx->name, pcTaskGetName(NULL), sizeof(ctx->name));
+    portMUX_INITIALIZE(&ctx->lock);
+    ctx->domain = domain;
+    ctx->boost_hold_us = CONFIG_ESP_MICROSLEEP_PRIORITY_BOOST_HOLD_US;
+    ctx->latency_avg16 = domain->compensation * 16;
+    esp_microsleep_compensation_init(&ctx->compensation, CONFIG_ESP_MICROSLEEP_COMPENSATION_PERCENTILE);
+
+    portENTER_CRITICAL(&esp_microsleep_tasks_lock);
+    ctx->next = esp_microsleep_tasks;
+    esp_microsleep_tasks = ctx;
+    portEXIT_CRITICAL(&esp_microsleep_tasks_lock);
+#if CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS
+    vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, CONFIG_ESP_MICROSLEEP_TLS_INDEX, (void*) ctx, esp_microsleep_task_deleted);
+#else
+    vTaskSetThreadLocalStoragePointer(NULL, CONFIG_ESP_MICROSLEEP_TLS_INDEX, (void*) ctx);
+#endif
+}
+
+static esp_microsleep_task_t* esp_microsleep_get_task() {
+
+    esp_microsleep_task_t* ctx = (esp_microsleep_task_t*) pvTaskGetThreadLocalStoragePointer(NULL, CONFIG_ESP_MICROSLEEP_TLS_INDEX);
+    if (!ctx) {
+        ctx = calloc(1, sizeof(esp_microsleep_task_t));
+        assert(ctx);
+        esp_microsleep_attach(ctx, &esp_microsleep_default_domain);
+    }
+    return ctx;
+}
+
+static void esp_microsleep_create_timer(esp_microsleep_task_t* ctx) {
+
+    const esp_timer_create_args_t oneshot_timer_args = {
+        .callback = esp_microsleep_isr_handler,
+        .arg = (void*) ctx,
+        .dispatch_method = ESP_TIMER_ISR,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&oneshot_timer_args, &ctx->timer));
+}
+
+static void esp_microsleep_restore_callback(void* arg) {
+
+    esp_microsleep_task_t* ctx = (esp_microsleep_task_t*) arg;
+
+    portENTER_CRITICAL(&ctx->lock);
+    if (!ctx->restore_armed || !ctx->boosted) {
+        portEXIT_CRITICAL(&ctx->lock);
+        return;
+    }
+    ctx->restoring = true;
+    portEXIT_CRITICAL(&ctx->lock);
+
+    // Leave priority changes the task made itself in the meantime alone.
+    if (uxTaskPriorityGet(ctx->task) == ctx->boosted_priority) {
+        vTaskPrioritySet(ctx->task, ctx->base_priority);
+    }
+
+    portENTER_CRITICAL(&ctx->lock);
+    ctx->boosted = false;
+    ctx->restoring = false;
+    const bool waiting = ctx->restore_waiting;
+    ctx->restore_waiting = false;
+    portEXIT_CRITICAL(&ctx->lock);
+    if (waiting) { xSemaphoreGive(ctx->restored_sem); }
+}
+
+// Takes the boost state back from the restore timer. Afterwards, only the task itself touches its priority.
+static void esp_microsleep_create_restore_timer(esp_microsleep_task_t* ctx) {
+
+    const esp_timer_create_args_t restore_timer_args = {
+        .callback = esp_microsleep_restore_callback,
+        .arg = (void*) ctx,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "microsleep_boost",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&restore_timer_args, &ctx->restore_timer));
+    ctx->restored_sem = xSemaphoreCreateBinaryStatic(&ctx->restored_sem_buffer);
+}
+
+static void esp_microsleep_boost_disarm(esp_microsleep_task_t* ctx) {
+
+    if (!ctx->restore_timer) { return; }
+    esp_timer_stop(ctx->restore_timer);
+
+    portENTER_CRITICAL(&ctx->lock);
+    ctx->restore_armed = false;
+    const bool restoring = ctx->restoring;
+    ctx->restore_waiting = restoring;
+    portEXIT_CRITICAL(&ctx->lock);
+
+    // The restore callback is already past its check, wait for it to finish. Blocking rather than
+    // spinning lets the timer task finish, even if it was preempted by this task on the same core.
+    if (restoring) { xSemaphoreTake(ctx->restored_sem, portMAX_DELAY); }
+}
+
+static void esp_microsleep_boost_begin(esp_microsleep_task_t* ctx, UBaseType_t priority) {
+
+    esp_microsleep_boost_disarm(ctx);
+
+    if (!priority && !ctx->boosted) { return; }
+    if (!ctx->boosted) {
+        ctx->base_priority = uxTaskPriorityGet(NULL);
+    }
+    if (priority <= ctx->base_priority) {
+        if (ctx->boosted) {
+            vTaskPrioritySet(NULL, ctx->base_priority);
+            ctx->boosted = false;
+        }
+        return;
+    }
+    if (!ctx->restore_timer) {
+        esp_microsleep_create_restore_timer(ctx);
+    }
+    ctx->boosted = true;
+    ctx->boosted_priority = priority;
+    // A blocked task does not compete for the CPU, so raising the priority now takes effect at wakeup.
+    vTaskPrioritySet(NULL, priority);
+}
+
+static void esp_microsleep_boost_end(esp_microsleep_task_t* ctx) {
+
+    if (!ctx->boosted || !ctx->boost_hold_us) { return; }
+
+    portENTER_CRITICAL(&ctx->lock);
+    ctx->restore_armed = true;
+    portEXIT_CRITICAL(&ctx->lock);
+    ESP_ERROR_CHECK(esp_timer_start_once(ctx->restore_timer, ctx->boost_hold_us));
+}
+
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+// Attributes a late wakeup either to the task masking interrupts, if the timer interrupt was late,
+// or to the task occupying the sleeper's core, if the interrupt was on time.
+static void esp_microsleep_blame(esp_microsleep_task_t* ctx) {
+
+    const bool irq_masked = ctx->culprit_irq_masked;
+    const TaskHandle_t culprit = ctx->culprit;
+    esp_microsleep_count(ctx->domain, &ctx->domain->stats.late_wakeups);
+    if (!culprit) { return; }
+
+    portENTER_CRITICAL(&esp_microsleep_culprits_lock);
+    esp_microsleep_culprit_t* entry = NULL;
+    for (size_t i = 0; i < CONFIG_ESP_MICROSLEEP_CULPRITS_MAX; i++) {
+        if (esp_microsleep_culprits[i].task == culprit || !esp_microsleep_culprits[i].task) {
+            entry = &esp_microsleep_culprits[i];
+            break;
+        }
+    }
+    if (entry) {
+        if (!entry->task) {
+            entry->task = culprit;
+            strlcpy(entry->name, ctx->culprit_name, sizeof(entry->name));
+        }
+        entry->count++;
+        if (irq_masked) { entry->irq_masked++; }
+    } else {
+        ctx->domain->stats.late_wakeups_unattributed++;
+    }
+    portEXIT_CRITICAL(&esp_microsleep_culprits_lock);
+}
+
+size_t esp_microsleep_get_culprits(esp_microsleep_culprit_t* culprits, size_t max) {
+
+    size_t count = 0;
+    portENTER_CRITICAL(&esp_microsleep_culprits_lock);
+    for (size_t i = 0; i < CONFIG_ESP_MICROSLEEP_CULPRITS_MAX && esp_microsleep_culprits[i].task; i++) {
+        if (count < max) { culprits[count++] = esp_microsleep_culprits[i]; }
+    }
+    portEXIT_CRITICAL(&esp_microsleep_culprits_lock);
+    return count;
+}
+
+void esp_microsleep_reset_culprits() {
+
+    portENTER_CRITICAL(&esp_microsleep_culprits_lock);
+    memset(esp_microsleep_culprits, 0, sizeof(esp_microsleep_culprits));
+    portEXIT_CRITICAL(&esp_microsleep_culprits_lock);
+}
+#endif
+
+// Arms the timer of the task's domain backend to notify the task in `us` microseconds.
+static void esp_microsleep_arm(esp_microsleep_task_t* ctx, uint64_t now, uint64_t us) {
+
+    ctx->expiry = now + us;
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+    ctx->core = xPortGetCoreID();
+#endif
+    esp_microsleep_domain_handle_t domain = ctx->domain;
+    if (domain->backend == ESP_MICROSLEEP_BACKEND_TASK_TIMER) {
+        if (!ctx->timer) {
+            esp_microsleep_create_timer(ctx);
+        }
+        ESP_ERROR_CHECK(esp_timer_start_once(ctx->timer, us));
+        return;
+    }
+
+    portENTER_CRITICAL(&domain->sleepers_lock);
+    esp_microsleep_task_t** link = &domain->sleepers;
+    while (*link && (*link)->expiry <= ctx->expiry) { link = &(*link)->next_sleeper; }
+    ctx->next_sleeper = *link;
+    *link = ctx;
+    if (domain->sleepers == ctx) {
+        // New first sleeper, move the alarm forward.
+        esp_timer_stop(domain->timer);
+        ESP_ERROR_CHECK(esp_timer_start_once(domain->timer, us));
+    }
+    portEXIT_CRITICAL(&domain->sleepers_lock);
+}
+
+// Cancels the wakeup armed by esp_microsleep_arm.
+// Returns false, if it's too late and the wakeup has been or is being delivered.
+static bool esp_microsleep_disarm(esp_microsleep_task_t* ctx) {
+
+    esp_microsleep_domain_handle_t domain = ctx->domain;
+    if (domain->backend == ESP_MICROSLEEP_BACKEND_TASK_TIMER) {
+        return esp_timer_stop(ctx->timer) == ESP_OK;
+    }
+
+    bool pending = false;
+    portENTER_CRITICAL(&domain->sleepers_lock);
+    for (esp_microsleep_task_t** link = &domain->sleepers; *link; link = &(*link)->next_sleeper) {
+        if (*link == ctx) {
+            // If it was the first sleeper, the timer fires in vain and re-arms for the next one.
+            *link = ctx->next_sleeper;
+            pending = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&domain->sleepers_lock);
+    return pending;
+}
+
+// Sleeps `us` on the timer as part of a delay of `requested` µs. Unless the default policy is in use,
+// the latency is recorded for the compensation policies.
+static void esp_microsleep_timer_wait(esp_microsleep_task_t* ctx, uint64_t us, uint64_t requested, esp_microsleep_compensation_policy_t policy) {
+
+    const uint64_t start = esp_timer_get_time();
+    ESP_MICROSLEEP_PROFILE_MARK(arm_start);
+    esp_microsleep_arm(ctx, start, us);
+    ESP_MICROSLEEP_PROFILE_ADD(ESP_MICROSLEEP_PROFILE_ARM, arm_start);
+    xTaskNotifyWait(0, 0, NULL, portMAX_DELAY); // or ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    ESP_MICROSLEEP_PROFILE_MARK(wake_start);
+    const uint64_t end = esp_timer_get_time();
+    esp_microsleep_account(ctx, &ctx->sleep_us, end - start);
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+    if ((int64_t)(end - ctx->expiry) > CONFIG_ESP_MICROSLEEP_CULPRIT_THRESHOLD_US) { esp_microsleep_blame(ctx); }
+#endif
+
+    if (policy != ESP_MICROSLEEP_COMPENSATION_MEAN) {
+        esp_microsleep_compensation_observe(&ctx->compensation, requested, end - start > us ? end - start - us : 0);
+    }
+
+    // Track the wakeup latency of this task, the policy engine works on these.
+    const int32_t error16 = (int32_t)(end - start - us) * 16 - (int32_t) ctx->latency_avg16;
+    ctx->latency_avg16 += error16 / 8;
+    ctx->latency_dev16 += ((error16 < 0 ? -error16 : error16) - (int32_t) ctx->latency_dev16) / 8;
+    ESP_MICROSLEEP_PROFILE_ADD(ESP_MICROSLEEP_PROFILE_WAKE, wake_start);
+}
+
+// Sleeps on the timer with the wakeup priority raised to `boost`, if any. Busy-waits are never boosted,
+// spinning at the higher priority would only keep other tasks off the CPU.
+static void esp_microsleep_boosted_wait(esp_microsleep_task_t* ctx, uint64_t us, uint64_t requested, esp_microsleep_compensation_policy_t policy, UBaseType_t boost) {
+
+    if (!boost) {
+        esp_microsleep_timer_wait(ctx, us, requested, policy);
+        return;
+    }
+    esp_microsleep_boost_begin(ctx, boost);
+    esp_microsleep_timer_wait(ctx, us, requested, policy);
+    esp_microsleep_boost_end(ctx);
+}
+
+static void esp_microsleep_spin_until(esp_microsleep_task_t* ctx, uint64_t deadline) {
+
+    const uint64_t start = esp_timer_get_time();
+#ifdef CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN
+    esp_microsleep_critical_spin_until(ctx->domain, deadline);
+#else
+    if (start < deadline) { ets_delay_us(deadline - start); }
+#endif
+    esp_microsleep_account(ctx, &ctx->spin_us, esp_timer_get_time() - start);
+}
+
+#ifdef CONFIG_ESP_MICROSLEEP_BURST_DETECTION
+// Tracks back-to-back delays. Returns true, if the task is in a burst of short delays.
+static bool esp_microsleep_in_burst(esp_microsleep_task_t* ctx, uint64_t now, uint64_t us) {
+
+    if (now - ctx->last_return > CONFIG_ESP_MICROSLEEP_BURST_GAP_US) {
+        ctx->burst_calls = 0;
+        return false;
+    }
+    if (++ctx->burst_calls == CONFIG_ESP_MICROSLEEP_BURST_MIN_CALLS) {
+        esp_microsleep_count(ctx->domain, &ctx->domain->stats.bursts);
+    }
+    return ctx->burst_calls >= CONFIG_ESP_MICROSLEEP_BURST_MIN_CALLS && us <= CONFIG_ESP_MICROSLEEP_BURST_MAX_DELAY_US;
+}
+#endif
+
+// Picks the cheapest strategy expected to meet the task's SLA within its CPU budget.
+// Returns the expected wakeup latency to compensate for and the time to spin before the deadline.
+static esp_microsleep_strategy_t esp_microsleep_choose_strategy(esp_microsleep_task_t* ctx, uint64_t us, uint64_t* compensation, uint64_t* window) {
+
+    const uint64_t latency = ctx->latency_avg16 / 16;
+    const uint64_t spread = ctx->latency_dev16 / 8; // about two mean deviations
+    const uint64_t allowance = us * ctx->sla.cpu_budget_pct / 100;
+
+    *compensation = latency;
+    *window = 0;
+    if (us <= latency) {
+        // Too short to sleep at all.
+        return ESP_MICROSLEEP_STRATEGY_SPIN;
+    }
+    if (us <= latency + spread) {
+        // Too short to sleep reliably.
+        return allowance >= us ? ESP_MICROSLEEP_STRATEGY_SPIN : ESP_MICROSLEEP_STRATEGY_SLEEP;
+    }
+    if (spread <= ctx->sla.max_error_us) {
+        return ESP_MICROSLEEP_STRATEGY_SLEEP;
+    }
+    *window = spread < allowance ? spread : allowance;
+    return *window ? ESP_MICROSLEEP_STRATEGY_HYBRID : ESP_MICROSLEEP_STRATEGY_SLEEP;
 }
 
 uint64_t esp_microsleep_calibrate() {
@@ -48,39 +665,430 @@ uint64_t esp_microsleep_calibrate() {
     const uint64_t calibration_usec = 100;
     uint64_t compensation = 0;
 
-    esp_microsleep_delay(0); // to preheat the timer for this task
+    // Measure the raw timer wakeup latency, independent of the current compensation.
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    // Keep the timer's allocation and the cold first wakeup out of the measurement.
+    if (ctx->domain->backend == ESP_MICROSLEEP_BACKEND_TASK_TIMER && !ctx->timer) {
+        esp_microsleep_create_timer(ctx);
+    }
+    esp_microsleep_timer_wait(ctx, calibration_usec, calibration_usec, ESP_MICROSLEEP_COMPENSATION_MEAN);
     for (int i = 0; i < calibration_loops; i++) {
         uint64_t start = esp_timer_get_time();
-        esp_microsleep_delay(calibration_usec);
+        esp_microsleep_timer_wait(ctx, calibration_usec, calibration_usec, ESP_MICROSLEEP_COMPENSATION_MEAN);
         uint64_t diff = esp_timer_get_time() - start - calibration_usec;
         compensation += diff;
     }
-    esp_microsleep_compensation = compensation / calibration_loops;
-    return esp_microsleep_compensation;
+    ctx->domain->compensation = compensation / calibration_loops;
+    return ctx->domain->compensation;
+}
+
+uint64_t esp_microsleep_domain_get_compensation(esp_microsleep_domain_handle_t domain) {
+
+    domain = esp_microsleep_domain_or_default(domain);
+    esp_microsleep_config_t config;
+    esp_microsleep_domain_get_config(domain, &config);
+    return config.compensation_override ? config.compensation_us : domain->compensation;
 }
 
-void esp_microsleep_delay(uint64_t ms) {
+uint64_t esp_microsleep_get_compensation() {
 
-    esp_timer_handle_t timer = (esp_timer_handle_t) pvTaskGetThreadLocalStoragePointer(NULL, CONFIG_ESP_MICROSLEEP_TLS_INDEX);
-    if (!timer) {
-        const esp_timer_create_args_t oneshot_timer_args = {
-            .callback = esp_microsleep_isr_handler,
-            .arg = (void*) xTaskGetCurrentTaskHandle(),
+    return esp_microsleep_domain_get_compensation(NULL);
+}
+
+void esp_microsleep_domain_get_config(esp_microsleep_domain_handle_t domain, esp_microsleep_config_t* config) {
+
+    domain = esp_microsleep_domain_or_default(domain);
+    portENTER_CRITICAL(&domain->config_lock);
+    *config = domain->config;
+    portEXIT_CRITICAL(&domain->config_lock);
+}
+
+esp_err_t esp_microsleep_domain_set_config(esp_microsleep_domain_handle_t domain, const esp_microsleep_config_t* config) {
+
+    if (!config || config->mode > ESP_MICROSLEEP_STRATEGY_SPIN || config->policy > ESP_MICROSLEEP_COMPENSATION_DURATION) { return ESP_ERR_INVALID_ARG; }
+
+    domain = esp_microsleep_domain_or_default(domain);
+    portENTER_CRITICAL(&domain->config_lock);
+    domain->config = *config;
+    portEXIT_CRITICAL(&domain->config_lock);
+    return ESP_OK;
+}
+
+void esp_microsleep_get_config(esp_microsleep_config_t* config) {
+
+    esp_microsleep_domain_get_config(NULL, config);
+}
+
+esp_err_t esp_microsleep_set_config(const esp_microsleep_config_t* config) {
+
+    return esp_microsleep_domain_set_config(NULL, config);
+}
+
+esp_err_t esp_microsleep_domain_create(const char* name, esp_microsleep_backend_t backend, const esp_microsleep_config_t* config, esp_microsleep_domain_handle_t* domain) {
+
+    if (!name || !domain || backend > ESP_MICROSLEEP_BACKEND_SHARED_TIMER) { return ESP_ERR_INVALID_ARG; }
+    if (config && (config->mode > ESP_MICROSLEEP_STRATEGY_SPIN || config->policy > ESP_MICROSLEEP_COMPENSATION_DURATION)) { return ESP_ERR_INVALID_ARG; }
+    if (esp_microsleep_domain_find(name)) { return ESP_ERR_INVALID_STATE; }
+
+    esp_microsleep_domain_handle_t created = calloc(1, sizeof(struct esp_microsleep_domain));
+    if (!created) { return ESP_ERR_NO_MEM; }
+    strlcpy(created->name, name, sizeof(created->name));
+    created->backend = backend;
+    created->config = config ? *config : esp_microsleep_default_config;
+    portMUX_INITIALIZE(&created->config_lock);
+    portMUX_INITIALIZE(&created->sleepers_lock);
+
+    if (backend == ESP_MICROSLEEP_BACKEND_SHARED_TIMER) {
+        const esp_timer_create_args_t shared_timer_args = {
+            .callback = esp_microsleep_shared_isr_handler,
+            .arg = (void*) created,
             .dispatch_method = ESP_TIMER_ISR,
+            .name = "microsleep_shared",
         };
-        ESP_ERROR_CHECK(esp_timer_create(&oneshot_timer_args, &timer));
-        vTaskSetThreadLocalStoragePointer(NULL, CONFIG_ESP_MICROSLEEP_TLS_INDEX, (void*) timer);
+        esp_err_t err = esp_timer_create(&shared_timer_args, &created->timer);
+        if (err != ESP_OK) {
+            free(created);
+            return err;
+        }
     }
 
-    if (ms == 0) { return; }
+    portENTER_CRITICAL(&esp_microsleep_domains_lock);
+    created->next = esp_microsleep_domains;
+    esp_microsleep_domains = created;
+    portEXIT_CRITICAL(&esp_microsleep_domains_lock);
 
-    if (ms <= esp_microsleep_compensation) {
-        ets_delay_us(ms);
-        return;
+    *domain = created;
+    return ESP_OK;
+}
+
+esp_microsleep_domain_handle_t esp_microsleep_domain_find(const char* name) {
+
+    if (!name) { return NULL; }
+    esp_microsleep_domain_handle_t found = NULL;
+    portENTER_CRITICAL(&esp_microsleep_domains_lock);
+    for (esp_microsleep_domain_handle_t domain = esp_microsleep_domains; domain && !found; domain = domain->next) {
+        if (!strncmp(domain->name, name, sizeof(domain->name))) { found = domain; }
     }
+    portEXIT_CRITICAL(&esp_microsleep_domains_lock);
+    return found;
+}
 
-    ESP_ERROR_CHECK(esp_timer_start_once(timer, ms - esp_microsleep_compensation));
-    xTaskNotifyWait(0, 0, NULL, portMAX_DELAY); // or ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+const char* esp_microsleep_domain_get_name(esp_microsleep_domain_handle_t domain) {
+
+    return esp_microsleep_domain_or_default(domain)->name;
+}
+
+esp_err_t esp_microsleep_ctx_register(esp_microsleep_ctx_t* storage, esp_microsleep_domain_handle_t domain) {
+
+    if (!storage) { return ESP_ERR_INVALID_ARG; }
+    if (pvTaskGetThreadLocalStoragePointer(NULL, CONFIG_ESP_MICROSLEEP_TLS_INDEX)) { return ESP_ERR_INVALID_STATE; }
+
+    esp_microsleep_task_t* ctx = (esp_microsleep_task_t*) storage;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->caller_owned = true;
+    domain = esp_microsleep_domain_or_default(domain);
+    // Everything a delay might allocate lazily is allocated now.
+    if (domain->backend == ESP_MICROSLEEP_BACKEND_TASK_TIMER) {
+        esp_microsleep_create_timer(ctx);
+    }
+    esp_microsleep_create_restore_timer(ctx);
+    esp_microsleep_attach(ctx, domain);
+    return ESP_OK;
+}
+
+esp_err_t esp_microsleep_domain_bind(esp_microsleep_domain_handle_t domain) {
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    domain = esp_microsleep_domain_or_default(domain);
+    // A caller-owned context must not allocate behind the caller's back.
+    if (ctx->caller_owned && !ctx->timer && domain->backend == ESP_MICROSLEEP_BACKEND_TASK_TIMER) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ctx->domain = domain;
+    return ESP_OK;
+}
+
+// Shortens a wait of `us` to end with the innermost deadline scope.
+// Returns true, if the wait has been shortened or the scope has already expired.
+static bool esp_microsleep_clamp(esp_microsleep_task_t* ctx, uint64_t now, uint64_t* us) {
+
+    if (!ctx->deadline_depth) { return false; }
+    const uint64_t limit = ctx->deadlines[ctx->deadline_depth - 1];
+    if (limit <= now) {
+        *us = 0;
+        return true;
+    }
+    if (now + *us <= limit) { return false; }
+    *us = limit - now;
+    return true;
+}
+
+static esp_err_t esp_microsleep_delay_internal(esp_microsleep_task_t* ctx, uint64_t ms, UBaseType_t boost) {
+
+    ESP_MICROSLEEP_PROFILE_MARK(prepare_start);
+    const uint64_t now = esp_timer_get_time();
+    const esp_err_t result = esp_microsleep_clamp(ctx, now, &ms) ? ESP_ERR_TIMEOUT : ESP_OK;
+    if (ms == 0) { return result; }
+
+    const uint64_t deadline = now + ms;
+    esp_microsleep_domain_handle_t domain = ctx->domain;
+    esp_microsleep_count(domain, &ctx->calls);
+    // Only timer sleeps are boosted, see esp_microsleep_boosted_wait. A delay without boost drops a pending one.
+    if (!boost && ctx->boosted) { esp_microsleep_boost_begin(ctx, 0); }
+
+    // Delays in flight keep the configuration they started with.
+    esp_microsleep_config_t config;
+    esp_microsleep_domain_get_config(domain, &config);
+
+    esp_microsleep_strategy_t strategy;
+    uint64_t compensation = config.compensation_override ? config.compensation_us
+                          : esp_microsleep_compensation_get(&ctx->compensation, config.policy, domain->compensation, ms);
+    uint64_t window = 0;
+#ifdef CONFIG_ESP_MICROSLEEP_BURST_DETECTION
+    if (esp_microsleep_in_burst(ctx, now, ms)) {
+        // Arming a timer for each of many short back-to-back delays costs more than it saves.
+        esp_microsleep_count(domain, &domain->stats.burst_spins);
+        strategy = ESP_MICROSLEEP_STRATEGY_SPIN;
+    } else
+#endif
+    if (ctx->sla_enabled) {
+        strategy = esp_microsleep_choose_strategy(ctx, ms, &compensation, &window);
+    } else if (ms <= compensation || ms <= config.spin_threshold_us) {
+        strategy = ESP_MICROSLEEP_STRATEGY_SPIN;
+    } else {
+        strategy = config.mode;
+#ifdef CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN
+        window = CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN_MAX_US;
+#else
+        window = ctx->latency_dev16 / 8;
+#endif
+    }
+
+    ESP_MICROSLEEP_PROFILE_ADD(ESP_MICROSLEEP_PROFILE_PREPARE, prepare_start);
+
+    uint64_t armed = 0;
+    switch (strategy) {
+        case ESP_MICROSLEEP_STRATEGY_SPIN:
+            esp_microsleep_count(domain, &domain->stats.strategy_spin);
+            ets_delay_us(ms);
+            esp_microsleep_account(ctx, &ctx->spin_us, ms);
+            break;
+        case ESP_MICROSLEEP_STRATEGY_SLEEP:
+            esp_microsleep_count(domain, &domain->stats.delays);
+            esp_microsleep_count(domain, &domain->stats.strategy_sleep);
+            if (ms > compensation) {
+                armed = ms - compensation;
+                esp_microsleep_boosted_wait(ctx, armed, ms, config.policy, boost);
+            }
+            break;
+        case ESP_MICROSLEEP_STRATEGY_HYBRID:
+            esp_microsleep_count(domain, &domain->stats.delays);
+            esp_microsleep_count(domain, &domain->stats.strategy_hybrid);
+            if (ms > compensation + window) {
+                armed = ms - compensation - window;
+                esp_microsleep_boosted_wait(ctx, armed, ms, config.policy, boost);
+            }
+            esp_microsleep_spin_until(ctx, deadline);
+            break;
+    }
+#if defined(CONFIG_ESP_MICROSLEEP_BURST_DETECTION) || defined(CONFIG_ESP_MICROSLEEP_ALERTS) || defined(CONFIG_ESP_MICROSLEEP_TRACE)
+    const uint64_t end = esp_timer_get_time();
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_TRACE
+    esp_microsleep_trace_record(&ctx->trace_id, &ctx->trace_generation, ctx->name, strategy, end, ms, armed, end - now);
+#else
+    (void) armed;
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_ALERTS
+    esp_microsleep_alert_feed(ctx->task, ctx->alert_streaks, end > deadline ? end - deadline : 0);
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_BURST_DETECTION
+    ctx->last_return = end;
+#endif
+    return result;
+}
+
+esp_err_t esp_microsleep_delay(uint64_t ms) {
+
+    ESP_MICROSLEEP_PROFILE_MARK(lookup_start);
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    ESP_MICROSLEEP_PROFILE_ADD(ESP_MICROSLEEP_PROFILE_LOOKUP, lookup_start);
+    return esp_microsleep_delay_internal(ctx, ms, ctx->boost_priority);
+}
+
+esp_err_t esp_microsleep_delay_unscoped(uint64_t us) {
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    const uint8_t depth = ctx->deadline_depth;
+    ctx->deadline_depth = 0;
+    const esp_err_t result = esp_microsleep_delay_internal(ctx, us, ctx->boost_priority);
+    ctx->deadline_depth = depth;
+    return result;
+}
+
+esp_err_t esp_microsleep_deadline_push(uint64_t budget_us) {
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    if (ctx->deadline_depth >= CONFIG_ESP_MICROSLEEP_DEADLINE_DEPTH) { return ESP_ERR_INVALID_STATE; }
+
+    uint64_t deadline = esp_timer_get_time() + budget_us;
+    if (ctx->deadline_depth && ctx->deadlines[ctx->deadline_depth - 1] < deadline) {
+        deadline = ctx->deadlines[ctx->deadline_depth - 1];
+    }
+    ctx->deadlines[ctx->deadline_depth++] = deadline;
+    return ESP_OK;
+}
+
+esp_err_t esp_microsleep_deadline_pop() {
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    if (!ctx->deadline_depth) { return ESP_ERR_INVALID_STATE; }
+    ctx->deadline_depth--;
+    return ESP_OK;
+}
+
+uint64_t esp_microsleep_deadline_remaining() {
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    uint64_t remaining = UINT64_MAX;
+    esp_microsleep_clamp(ctx, esp_timer_get_time(), &remaining);
+    return remaining;
+}
+
+esp_err_t esp_microsleep_select(QueueSetHandle_t set, uint64_t timeout_us, QueueSetMemberHandle_t* member) {
+
+    if (!set || !member) { return ESP_ERR_INVALID_ARG; }
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    if (!ctx->select_sem) {
+        ctx->select_sem = xSemaphoreCreateBinaryStatic(&ctx->select_sem_buffer);
+        if (xQueueAddToSet(ctx->select_sem, set) != pdPASS) {
+            vSemaphoreDelete(ctx->select_sem);
+            ctx->select_sem = NULL;
+            return ESP_ERR_INVALID_STATE;
+        }
+        ctx->select_set = set;
+    }
+    if (set != ctx->select_set) { return ESP_ERR_INVALID_STATE; }
+
+    const uint64_t start = esp_timer_get_time();
+    esp_microsleep_clamp(ctx, start, &timeout_us);
+    const uint64_t deadline = start + timeout_us;
+    ctx->selecting = true;
+    esp_microsleep_arm(ctx, start, timeout_us);
+    for (;;) {
+        *member = xQueueSelectFromSet(set, portMAX_DELAY);
+        if (*member != ctx->select_sem) { break; }
+        // Events of our semaphore before the deadline are left over from earlier calls.
+        xSemaphoreTake(ctx->select_sem, 0);
+        if ((uint64_t) esp_timer_get_time() >= deadline) {
+            ctx->selecting = false;
+            *member = NULL;
+            esp_microsleep_account(ctx, &ctx->sleep_us, esp_timer_get_time() - start);
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    if (!esp_microsleep_disarm(ctx)) {
+        // Let the wakeup in flight land on the semaphore, its event is skipped next time.
+        xSemaphoreTake(ctx->select_sem, portMAX_DELAY);
+    }
+    ctx->selecting = false;
+    esp_microsleep_account(ctx, &ctx->sleep_us, esp_timer_get_time() - start);
+    return ESP_OK;
+}
+
+esp_err_t esp_microsleep_delay_boosted(uint64_t us, UBaseType_t priority) {
+
+    return esp_microsleep_delay_internal(esp_microsleep_get_task(), us, priority);
+}
+
+void esp_microsleep_set_priority_boost(UBaseType_t priority, uint64_t hold_us) {
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    ctx->boost_priority = priority;
+    ctx->boost_hold_us = hold_us;
+}
+
+esp_err_t esp_microsleep_delay_warm(uint64_t us, esp_microsleep_warmup_t warmup, void* arg) {
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    const uint64_t now = esp_timer_get_time();
+    const esp_err_t result = esp_microsleep_clamp(ctx, now, &us) ? ESP_ERR_TIMEOUT : ESP_OK;
+    const uint64_t deadline = now + us;
+
+    // Wake up early enough to run the hook and absorb the wakeup jitter, then spin out the rest.
+    const uint64_t lead = ctx->warmup_avg16 / 16 + ctx->latency_dev16 / 8;
+    if (us > lead) {
+        esp_microsleep_delay_internal(ctx, us - lead, ctx->boost_priority);
+    }
+    if (warmup) {
+        const uint64_t start = esp_timer_get_time();
+        warmup(arg);
+        const uint64_t end = esp_timer_get_time();
+        ctx->warmup_avg16 += ((int32_t)(end - start) * 16 - (int32_t) ctx->warmup_avg16) / 8;
+        if (end > deadline) {
+            esp_microsleep_count(ctx->domain, &ctx->domain->stats.warmup_overruns);
+        }
+    }
+    esp_microsleep_spin_until(ctx, deadline);
+    return result;
+}
+
+size_t esp_microsleep_get_task_stats(esp_microsleep_task_stats_t* stats, size_t max) {
+
+    size_t count = 0;
+    portENTER_CRITICAL(&esp_microsleep_tasks_lock);
+    for (esp_microsleep_task_t* ctx = esp_microsleep_tasks; ctx; ctx = ctx->next, count++) {
+        if (count >= max) { continue; }
+        esp_microsleep_task_stats_t* entry = &stats[count];
+        entry->task = ctx->task;
+        memcpy(entry->name, ctx->name, sizeof(entry->name));
+        entry->calls = ctx->calls;
+        entry->wakeups = ctx->wakeups;
+        portENTER_CRITICAL(&ctx->lock);
+        entry->spin_us = ctx->spin_us;
+        entry->sleep_us = ctx->sleep_us;
+        portEXIT_CRITICAL(&ctx->lock);
+    }
+    portEXIT_CRITICAL(&esp_microsleep_tasks_lock);
+    return count;
+}
+
+void esp_microsleep_get_task_stats_table(char* buffer, size_t length) {
+
+    esp_microsleep_task_stats_t stats[CONFIG_ESP_MICROSLEEP_TASK_STATS_MAX];
+    size_t count = esp_microsleep_get_task_stats(stats, CONFIG_ESP_MICROSLEEP_TASK_STATS_MAX);
+    if (count > CONFIG_ESP_MICROSLEEP_TASK_STATS_MAX) { count = CONFIG_ESP_MICROSLEEP_TASK_STATS_MAX; }
+
+    size_t used = snprintf(buffer, length, "%-*s %10s %10s %12s %12s\n", configMAX_TASK_NAME_LEN, "Task", "Calls", "Wakeups", "Sleep (us)", "Spin (us)");
+    for (size_t i = 0; i < count && used < length; i++) {
+        used += snprintf(buffer + used, length - used, "%-*s %10lu %10lu %12llu %12llu\n", configMAX_TASK_NAME_LEN, stats[i].name,
+                         (unsigned long) stats[i].calls, (unsigned long) stats[i].wakeups,
+                         (unsigned long long) stats[i].sleep_us, (unsigned long long) stats[i].spin_us);
+    }
+}
+
+esp_err_t esp_microsleep_set_sla(const esp_microsleep_sla_t* sla) {
+
+    if (sla && sla->cpu_budget_pct > 100) { return ESP_ERR_INVALID_ARG; }
+
+    esp_microsleep_task_t* ctx = esp_microsleep_get_task();
+    if (sla) {
+        ctx->sla = *sla;
+    }
+    ctx->sla_enabled = sla != NULL;
+    return ESP_OK;
+}
+
+void esp_microsleep_priority_restore() {
+
+    esp_microsleep_boost_begin(esp_microsleep_get_task(), 0);
+}
+
+esp_err_t esp_microsleep_delay_until(uint64_t deadline_us) {
+
+    uint64_t now = esp_timer_get_time();
+    return esp_microsleep_delay(deadline_us > now ? deadline_us - now : 0);
 }
 
 #endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX
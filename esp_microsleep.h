@@ -28,8 +28,15 @@
 #ifndef ESP_MICROSLEEP_H
 #define ESP_MICROSLEEP_H
 
+#include "stdbool.h" // for bool
 #include "stdint.h" // for uint64_t
 #include "sdkconfig.h" // for CONFIG_*
+#include "stddef.h" // for size_t
+#include "freertos/FreeRTOS.h" // for UBaseType_t, StaticSemaphore_t, portMUX_TYPE
+#include "freertos/task.h" // for TaskHandle_t
+#include "freertos/queue.h" // for QueueSetHandle_t
+#include "esp_err.h" // for esp_err_t
+#include "esp_microsleep_compensation.h" // for esp_microsleep_compensation_policy_t
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,19 +44,320 @@ extern "C" {
 
 #if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
 
+/**
+ * @brief How a delay is carried out.
+ */
+typedef enum {
+    ESP_MICROSLEEP_STRATEGY_SLEEP = 0,  ///< Timer sleep, compensated for the expected wakeup latency. Cheapest.
+    ESP_MICROSLEEP_STRATEGY_HYBRID,     ///< Timer sleep ending slightly early, spin for the rest.
+    ESP_MICROSLEEP_STRATEGY_SPIN,       ///< Busy wait for the whole delay. Most accurate, burns the CPU.
+} esp_microsleep_strategy_t;
+
+/**
+ * @brief Runtime configuration.
+ *
+ * See `esp_microsleep_set_config`.
+ */
+typedef struct {
+    bool compensation_override;          ///< Use `compensation_us` instead of the value computed by `esp_microsleep_calibrate`.
+    uint32_t compensation_us;            ///< Expected wakeup latency, subtracted from every timer sleep.
+    esp_microsleep_compensation_policy_t policy; ///< How the compensation is determined, unless overridden. Defaults to the calibrated mean.
+    uint32_t spin_threshold_us;          ///< Delays up to this are busy waited. Delays shorter than the compensation are always busy waited.
+    esp_microsleep_strategy_t mode;      ///< Strategy for tasks without an SLA, see `esp_microsleep_set_sla`.
+                                         ///< Defaults to `ESP_MICROSLEEP_STRATEGY_SLEEP`, or `ESP_MICROSLEEP_STRATEGY_HYBRID` with
+                                         ///< CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN. The final spin of a hybrid delay covers
+                                         ///< CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN_MAX_US, if enabled, or the task's wakeup jitter otherwise.
+    bool stats_enabled;                  ///< Collect the global and per-task statistics. Enabled by default.
+} esp_microsleep_config_t;
+
+/**
+ * @brief Timing requirements of a task.
+ *
+ * See `esp_microsleep_set_sla`.
+ */
+typedef struct {
+    uint32_t max_error_us;   ///< Tolerated deviation from the requested wakeup time.
+    uint8_t cpu_budget_pct;  ///< Share of the delay time the task may spend busy waiting, 0-100.
+} esp_microsleep_sla_t;
+
+/**
+ * @brief Warm-up hook for `esp_microsleep_delay_warm`.
+ */
+typedef void (*esp_microsleep_warmup_t)(void* arg);
+
+/**
+ * @brief Runtime statistics of the microsleep engine.
+ *
+ * All counters are cumulative since boot or the last call to `esp_microsleep_reset_stats`.
+ */
+typedef struct {
+    uint32_t delays;                  ///< Number of timer-backed delays.
+    uint32_t wakeups;                 ///< Number of timer interrupts waking up a sleeping task.
+    uint32_t wakeup_yields;           ///< Wakeups that preempted the running task, because the sleeper had a higher priority.
+    uint32_t strategy_sleep;          ///< Delays served by a timer sleep.
+    uint32_t strategy_hybrid;         ///< Delays served by a timer sleep followed by a spin.
+    uint32_t strategy_spin;           ///< Delays served by busy waiting.
+    uint32_t bursts;                  ///< Bursts of back-to-back short delays detected.
+    uint32_t burst_spins;             ///< Delays spun instead of slept, because they were part of a burst.
+    uint32_t warmup_overruns;         ///< Warm-up hooks of `esp_microsleep_delay_warm` that ended after the deadline.
+    uint32_t late_wakeups;            ///< Wakeups later than CONFIG_ESP_MICROSLEEP_CULPRIT_THRESHOLD_US, see `esp_microsleep_get_culprits`.
+    uint32_t late_wakeups_unattributed; ///< Late wakeups not recorded, because the culprit table was full.
+    uint32_t critical_spins;          ///< Final spins that ran with interrupts masked.
+    uint32_t critical_spin_cap_hits;  ///< Final spins longer than CONFIG_ESP_MICROSLEEP_CRITICAL_SPIN_MAX_US, only the tail was masked.
+    uint32_t critical_spin_late;      ///< Wakeups that were already past the deadline, no final spin needed.
+} esp_microsleep_stats_t;
+
+/**
+ * @brief Per-task accounting of the microsleep engine.
+ *
+ * See `esp_microsleep_get_task_stats`.
+ */
+typedef struct {
+    TaskHandle_t task;                     ///< Task handle.
+    char name[configMAX_TASK_NAME_LEN];    ///< Task name.
+    uint32_t calls;                        ///< Number of delays.
+    uint32_t wakeups;                      ///< Number of timer interrupts waking up the task.
+    uint64_t spin_us;                      ///< Time spent busy waiting.
+    uint64_t sleep_us;                     ///< Time spent blocked on the timer.
+} esp_microsleep_task_stats_t;
+
+/**
+ * @brief A task blamed for late wakeups.
+ *
+ * See `esp_microsleep_get_culprits`.
+ */
+typedef struct {
+    TaskHandle_t task;                     ///< Task handle. Might be stale, if the task has been deleted.
+    char name[configMAX_TASK_NAME_LEN];    ///< Task name.
+    uint32_t count;                        ///< Late wakeups attributed to this task.
+    uint32_t irq_masked;                   ///< Thereof with the timer interrupt itself being late, i.e. interrupts masked by this task.
+} esp_microsleep_culprit_t;
+
+/**
+ * @brief How the tasks of a domain are woken up.
+ */
+typedef enum {
+    ESP_MICROSLEEP_BACKEND_TASK_TIMER = 0,  ///< One esp_timer per task, created on its first delay.
+    ESP_MICROSLEEP_BACKEND_SHARED_TIMER,    ///< One esp_timer per domain, serving all of its sleeping tasks.
+} esp_microsleep_backend_t;
+
+/**
+ * @brief Handle of a microsleep domain.
+ *
+ * A domain groups tasks sharing the compensation, runtime configuration, statistics and
+ * timer backend, so that e.g. a motor control loop can be tuned independently from a
+ * sensor poller. Tasks belong to the "default" domain until bound to another one.
+ */
+typedef struct esp_microsleep_domain* esp_microsleep_domain_handle_t;
+
+/**
+ * @brief Storage for a per-task context, see `esp_microsleep_ctx_register`.
+ *
+ * Like `StaticTask_t`, this is opaque: the members only reserve the size and alignment of the
+ * private context and must not be accessed.
+ */
+typedef struct {
+    void* dummy1[4];
+    uint64_t dummy2;
+    void* dummy3;
+    char dummy4[configMAX_TASK_NAME_LEN];
+    bool dummy5;
+    portMUX_TYPE dummy6;
+    UBaseType_t dummy7;
+    uint64_t dummy8;
+    UBaseType_t dummy9[2];
+    bool dummy10[4];
+    void* dummy11[2];
+    StaticSemaphore_t dummy12;
+    bool dummy13;
+    void* dummy14;
+    StaticSemaphore_t dummy15;
+    void* dummy16;
+    uint64_t dummy17[CONFIG_ESP_MICROSLEEP_DEADLINE_DEPTH];
+    uint8_t dummy18;
+    esp_microsleep_compensation_t dummy19;
+    uint32_t dummy20[3];
+    bool dummy21;
+    esp_microsleep_sla_t dummy22;
+    uint32_t dummy23[2];
+    uint64_t dummy24[2];
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+    BaseType_t dummy25;
+    void* dummy26;
+    bool dummy27;
+    char dummy28[configMAX_TASK_NAME_LEN];
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_ALERTS
+    uint16_t dummy29[2 * CONFIG_ESP_MICROSLEEP_ALERTS_MAX];
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_TRACE
+    uint16_t dummy30[2];
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_BURST_DETECTION
+    uint64_t dummy31;
+    uint32_t dummy32;
+#endif
+} esp_microsleep_ctx_t;
+
 /**
  * @brief Calibrate the microsleep compensation value.
  *
- * Adjusts the global microsleep compensation value for your system.
+ * Adjusts the microsleep compensation value of the calling task's domain for your system.
  *
  * On an ESP32S3 with a 240Mhz CPU clock, the compensation value is 15.
  * It may be higher, if you have more tasks running microsleep at the same time.
  *
  * It's advisable to calibrate when the system is under typical load, i.e.
- * not necessarily when the system is idle or booting.
+ * not necessarily when the system is idle or booting. With `CONFIG_ESP_MICROSLEEP_LOAD`,
+ * `esp_microsleep_calibrate_under_load` generates such a load reproducibly.
 */
 uint64_t esp_microsleep_calibrate();
 
+/**
+ * @brief Get the microsleep compensation value of the default domain.
+ *
+ * @return Compensation in microseconds, as computed by `esp_microsleep_calibrate` or overridden
+ *         in the runtime configuration.
+ */
+uint64_t esp_microsleep_get_compensation();
+
+/**
+ * @brief Get the current runtime configuration of the default domain.
+ *
+ * @param[out] config Receives the configuration.
+ *
+ * @return None.
+ */
+void esp_microsleep_get_config(esp_microsleep_config_t* config);
+
+/**
+ * @brief Change the runtime configuration of the default domain.
+ *
+ * The new configuration is applied atomically and takes effect with the next delay;
+ * delays in flight finish with the configuration they started with.
+ * Start from `esp_microsleep_get_config` to only change some of the settings.
+ *
+ * @param[in] config New configuration.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid configuration.
+ */
+esp_err_t esp_microsleep_set_config(const esp_microsleep_config_t* config);
+
+/**
+ * @brief Create a microsleep domain.
+ *
+ * Domains live until reboot. The compensation of a new domain is zero until a task bound
+ * to it calls `esp_microsleep_calibrate`.
+ *
+ * @param[in] name Unique name of the domain, at most CONFIG_ESP_MICROSLEEP_DOMAIN_NAME_LEN - 1 characters are kept.
+ * @param[in] backend How the tasks of the domain are woken up.
+ * @param[in] config Initial runtime configuration, or NULL for the defaults.
+ * @param[out] domain Receives the handle of the new domain.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for invalid arguments, ESP_ERR_INVALID_STATE
+ *         if the name is taken, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t esp_microsleep_domain_create(const char* name, esp_microsleep_backend_t backend, const esp_microsleep_config_t* config, esp_microsleep_domain_handle_t* domain);
+
+/**
+ * @brief Register caller-owned storage as the context of the current task.
+ *
+ * Without registration, the context is allocated on the first delay of a task. Registering
+ * a statically allocated context during initialization instead binds the task to `domain`
+ * and creates all timers the task needs upfront, so that subsequent delays do not allocate
+ * and the first delay is as fast as any other. Combined with a domain using
+ * ESP_MICROSLEEP_BACKEND_SHARED_TIMER, not even a per-task timer is needed.
+ *
+ * The storage must outlive the task. Binding the task to a domain using
+ * ESP_MICROSLEEP_BACKEND_TASK_TIMER later on fails, unless it was registered with one.
+ *
+ * @param[in] storage Storage for the context.
+ * @param[in] domain The domain to bind the task to, or NULL for the default domain.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if `storage` is NULL, ESP_ERR_INVALID_STATE
+ *         if the task already has a context.
+ */
+esp_err_t esp_microsleep_ctx_register(esp_microsleep_ctx_t* storage, esp_microsleep_domain_handle_t domain);
+
+/**
+ * @brief Look up a domain by name.
+ *
+ * @param[in] name Name of the domain.
+ *
+ * @return Handle of the domain, or NULL if there is no such domain.
+ */
+esp_microsleep_domain_handle_t esp_microsleep_domain_find(const char* name);
+
+/**
+ * @brief Get the name of a domain.
+ *
+ * @param[in] domain The domain, or NULL for the default domain.
+ *
+ * @return Name of the domain.
+ */
+const char* esp_microsleep_domain_get_name(esp_microsleep_domain_handle_t domain);
+
+/**
+ * @brief Bind the current task to a domain.
+ *
+ * Subsequent delays of the task use the compensation, configuration, statistics and backend
+ * of the domain. Do not rebind while another task is inspecting this one.
+ *
+ * @param[in] domain The domain, or NULL for the default domain.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the task registered caller-owned
+ *         storage without a per-task timer, but `domain` needs one.
+ */
+esp_err_t esp_microsleep_domain_bind(esp_microsleep_domain_handle_t domain);
+
+/**
+ * @brief Domain specific `esp_microsleep_get_compensation`.
+ *
+ * @param[in] domain The domain, or NULL for the default domain.
+ *
+ * @return Compensation in microseconds.
+ */
+uint64_t esp_microsleep_domain_get_compensation(esp_microsleep_domain_handle_t domain);
+
+/**
+ * @brief Domain specific `esp_microsleep_get_config`.
+ *
+ * @param[in] domain The domain, or NULL for the default domain.
+ * @param[out] config Receives the configuration.
+ *
+ * @return None.
+ */
+void esp_microsleep_domain_get_config(esp_microsleep_domain_handle_t domain, esp_microsleep_config_t* config);
+
+/**
+ * @brief Domain specific `esp_microsleep_set_config`.
+ *
+ * @param[in] domain The domain, or NULL for the default domain.
+ * @param[in] config New configuration.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid configuration.
+ */
+esp_err_t esp_microsleep_domain_set_config(esp_microsleep_domain_handle_t domain, const esp_microsleep_config_t* config);
+
+/**
+ * @brief Domain specific `esp_microsleep_get_stats`.
+ *
+ * @param[in] domain The domain, or NULL for the default domain.
+ * @param[out] stats Receives the current counters.
+ *
+ * @return None.
+ */
+void esp_microsleep_domain_get_stats(esp_microsleep_domain_handle_t domain, esp_microsleep_stats_t* stats);
+
+/**
+ * @brief Domain specific `esp_microsleep_reset_stats`.
+ *
+ * @param[in] domain The domain, or NULL for the default domain.
+ *
+ * @return None.
+ */
+void esp_microsleep_domain_reset_stats(esp_microsleep_domain_handle_t domain);
+
 /**
  * @brief Delay the current task for a specified number of microseconds.
  *
@@ -66,9 +374,221 @@ uint64_t esp_microsleep_calibrate();
  *
  * @param[in] us Number of microseconds to delay.
  *
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if the delay has been cut short by the task's deadline scope,
+ *         see `esp_microsleep_deadline_push`.
+ */
+esp_err_t esp_microsleep_delay(uint64_t us);
+
+/**
+ * @brief Delay the current task until an absolute point in time.
+ *
+ * Like `esp_microsleep_delay`, but the wakeup time is given as an absolute
+ * `esp_timer_get_time()` timestamp. Chaining calls against a fixed time base
+ * avoids accumulating the per-call overhead. Returns immediately, if the
+ * deadline has already passed.
+ *
+ * @param[in] deadline_us Absolute wakeup time in microseconds since boot.
+ *
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if the delay has been cut short by the task's deadline scope,
+ *         see `esp_microsleep_deadline_push`.
+ */
+esp_err_t esp_microsleep_delay_until(uint64_t deadline_us);
+
+/**
+ * @brief Delay the current task and warm up the caches before the deadline.
+ *
+ * Code running right after a wakeup often resides in flash and misses the cache, adding
+ * several microseconds to the latency of the section following the delay. This function
+ * wakes up the task early, calls `warmup` (e.g. touching the code and data of the critical
+ * section) and spins until the exact deadline. The lead time is learned per task from the
+ * duration of the hook and the wakeup jitter.
+ *
+ * @param[in] us Number of microseconds to delay.
+ * @param[in] warmup Hook to run before the deadline. May be NULL to just spin the final part.
+ * @param[in] arg Argument passed to `warmup`.
+ *
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if the delay has been cut short by the task's deadline scope,
+ *         see `esp_microsleep_deadline_push`.
+ */
+esp_err_t esp_microsleep_delay_warm(uint64_t us, esp_microsleep_warmup_t warmup, void* arg);
+
+/**
+ * @brief Open a deadline scope for the current task.
+ *
+ * Until the matching `esp_microsleep_deadline_pop`, all delays and waits of the task end
+ * no later than `budget_us` from now and report ESP_ERR_TIMEOUT, if they had to be cut
+ * short. This keeps an operation composed of several waits within its overall budget.
+ * Scopes nest up to CONFIG_ESP_MICROSLEEP_DEADLINE_DEPTH deep; an inner scope never
+ * extends the deadline of an outer one.
+ *
+ * @param[in] budget_us Time budget of the scope in microseconds.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if scopes are nested too deep.
+ */
+esp_err_t esp_microsleep_deadline_push(uint64_t budget_us);
+
+/**
+ * @brief Close the innermost deadline scope of the current task.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if there is no open scope.
+ */
+esp_err_t esp_microsleep_deadline_pop();
+
+/**
+ * @brief Get the time left in the innermost deadline scope of the current task.
+ *
+ * Use this to pass the remaining budget on to blocking calls that are not microsleep-aware.
+ *
+ * @return Remaining microseconds, 0 if the deadline has passed, UINT64_MAX without a scope.
+ */
+uint64_t esp_microsleep_deadline_remaining();
+
+/**
+ * @brief Wait for a member of a queue set to become ready, with a timeout in microseconds.
+ *
+ * This is the microsecond counterpart to `xQueueSelectFromSet`, whose timeout is limited to
+ * ticks. On the first call, a semaphore owned by the task is added to the set and given by
+ * the microsleep timer; thus the set must be created with room for one more event, and
+ * should only be waited on via this function, which skips the semaphore's events.
+ * A task can only select from one queue set.
+ *
+ * @param[in] set The queue set.
+ * @param[in] timeout_us Timeout in microseconds.
+ * @param[out] member Receives the ready member, like `xQueueSelectFromSet` returns it.
+ *
+ * @return ESP_OK if a member is ready, ESP_ERR_TIMEOUT if none became ready in time or
+ *         within the task's deadline scope,
+ *         ESP_ERR_INVALID_ARG for invalid arguments, ESP_ERR_INVALID_STATE if the task
+ *         already selected from a different set or the set is full.
+ */
+esp_err_t esp_microsleep_select(QueueSetHandle_t set, uint64_t timeout_us, QueueSetMemberHandle_t* member);
+
+/**
+ * @brief Delay the current task and raise its priority for the wakeup.
+ *
+ * Like `esp_microsleep_delay`, but the task wakes up with the given priority, so it is not
+ * held up in the ready list behind other work. The original priority is restored on the next
+ * delay without boost, by `esp_microsleep_priority_restore`, or when the hold time configured
+ * with `esp_microsleep_set_priority_boost` (default: CONFIG_ESP_MICROSLEEP_PRIORITY_BOOST_HOLD_US)
+ * has elapsed after the wakeup. Delays short enough to be spun through are not boosted, and the
+ * priority is only restored if the task hasn't changed it in the meantime.
+ *
+ * @param[in] us Number of microseconds to delay.
+ * @param[in] priority Priority to run with after the wakeup. Ignored, if not higher than the current one.
+ *
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if the delay has been cut short by the task's deadline scope,
+ *         see `esp_microsleep_deadline_push`.
+ */
+esp_err_t esp_microsleep_delay_boosted(uint64_t us, UBaseType_t priority);
+
+/**
+ * @brief Configure the wakeup priority boost for the current task.
+ *
+ * After this, every `esp_microsleep_delay` of the current task behaves like
+ * `esp_microsleep_delay_boosted` with the given priority.
+ *
+ * @param[in] priority Priority to run with after a wakeup, 0 to disable the boost.
+ * @param[in] hold_us Time after the wakeup the boost is kept, 0 to keep it until the next delay.
+ *
+ * @return None.
+ */
+void esp_microsleep_set_priority_boost(UBaseType_t priority, uint64_t hold_us);
+
+/**
+ * @brief Register timing requirements for the current task.
+ *
+ * With an SLA, `esp_microsleep_delay` picks the strategy per call from the task's live wakeup
+ * latency statistics: it sleeps, if the expected spread of the wakeup time is within `max_error_us`,
+ * otherwise it ends the sleep early enough to spin out the spread, as far as `cpu_budget_pct` permits.
+ * Delays shorter than the expected wakeup latency are always spun, delays too short to sleep
+ * reliably are spun, if the budget allows for it.
+ *
+ * Without an SLA, delays are served with the global compensation from `esp_microsleep_calibrate`.
+ *
+ * @param[in] sla Timing requirements, NULL to remove them.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the CPU budget exceeds 100%.
+ */
+esp_err_t esp_microsleep_set_sla(const esp_microsleep_sla_t* sla);
+
+/**
+ * @brief Drop a pending wakeup priority boost of the current task.
+ *
+ * Call this at the end of the timing sensitive section to not wait for the hold time.
+ *
+ * @return None.
+ */
+void esp_microsleep_priority_restore();
+
+/**
+ * @brief Get a snapshot of the microsleep statistics of the default domain.
+ *
+ * @param[out] stats Receives the current counters.
+ *
+ * @return None.
+ */
+void esp_microsleep_get_stats(esp_microsleep_stats_t* stats);
+
+/**
+ * @brief Get the accounting of all tasks that have used the microsleep engine.
+ *
+ * This is the microsleep counterpart to `uxTaskGetSystemState`.
+ *
+ * Tasks are removed when they are deleted, which needs CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS.
+ * Without it, deleted tasks stay listed with a dangling handle, and their contexts are leaked.
+ *
+ * @param[out] stats Array receiving one entry per task.
+ * @param[in] max Number of entries in `stats`.
+ *
+ * @return Number of tasks known to the microsleep engine. If this is larger than `max`,
+ *         only the first `max` entries have been filled in.
+ */
+size_t esp_microsleep_get_task_stats(esp_microsleep_task_stats_t* stats, size_t max);
+
+/**
+ * @brief Format the per-task accounting as a human readable table.
+ *
+ * This is the microsleep counterpart to `vTaskGetRunTimeStats`. At most
+ * CONFIG_ESP_MICROSLEEP_TASK_STATS_MAX tasks are listed.
+ *
+ * @param[out] buffer Buffer receiving the zero terminated table.
+ * @param[in] length Size of `buffer`.
+ *
+ * @return None.
+ */
+void esp_microsleep_get_task_stats_table(char* buffer, size_t length);
+
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+/**
+ * @brief Get the tasks blamed for late wakeups.
+ *
+ * Whenever a task wakes up more than CONFIG_ESP_MICROSLEEP_CULPRIT_THRESHOLD_US after its timer
+ * was due, the wakeup is attributed to a culprit: If the timer interrupt itself was late by more
+ * than CONFIG_ESP_MICROSLEEP_CULPRIT_IRQ_LATENCY_US, interrupts have been masked and the task
+ * interrupted by the timer is blamed. Otherwise, the task that was running on the sleeper's
+ * core when the interrupt fired kept it from running and is blamed.
+ *
+ * @param[out] culprits Array receiving the culprits.
+ * @param[in] max Number of entries in `culprits`.
+ *
+ * @return Number of entries filled in.
+ */
+size_t esp_microsleep_get_culprits(esp_microsleep_culprit_t* culprits, size_t max);
+
+/**
+ * @brief Clear the culprit table.
+ *
+ * @return None.
+ */
+void esp_microsleep_reset_culprits();
+#endif
+
+/**
+ * @brief Reset the microsleep statistics of the default domain to zero.
+ *
  * @return None.
  */
-void esp_microsleep_delay(uint64_t us);
+void esp_microsleep_reset_stats();
 #else
 #warning esp_microsleep not available due to missing configuration
 #endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
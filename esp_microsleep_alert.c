@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_alert.h"
+#include "esp_microsleep_private.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include <string.h>
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_ALERTS)
+
+struct esp_microsleep_alert {
+    bool used;
+    uint16_t generation;  // bumped on unregister, voids queued events and the tasks' streaks
+    esp_microsleep_alert_config_t config;
+    esp_microsleep_alert_cb_t callback;
+    void* arg;
+    uint32_t samples;   // delays in the current window
+    uint32_t late;      // late delays in the current window
+};
+
+static struct esp_microsleep_alert esp_microsleep_alerts[CONFIG_ESP_MICROSLEEP_ALERTS_MAX];
+static uint32_t esp_microsleep_alerts_used = 0;
+static portMUX_TYPE esp_microsleep_alerts_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t esp_microsleep_alert_queue = NULL;
+static uint32_t esp_microsleep_alert_init_state = 0;  // 0: not done, 1: in progress, 2: done
+
+typedef struct {
+    esp_microsleep_alert_event_t event;
+    uint16_t generation;  // of the alert when it triggered
+} esp_microsleep_alert_queued_t;
+
+static void esp_microsleep_alert_task(void* arg) {
+
+    esp_microsleep_alert_queued_t queued;
+    for (;;) {
+        if (xQueueReceive(esp_microsleep_alert_queue, &queued, portMAX_DELAY) != pdTRUE) { continue; }
+
+        // Events of an alert unregistered since are dropped, even if its slot is in use again.
+        struct esp_microsleep_alert* alert = queued.event.alert;
+        portENTER_CRITICAL(&esp_microsleep_alerts_lock);
+        esp_microsleep_alert_cb_t callback = alert->used && alert->generation == queued.generation ? alert->callback : NULL;
+        void* callback_arg = alert->arg;
+        portEXIT_CRITICAL(&esp_microsleep_alerts_lock);
+
+        if (callback) { callback(&queued.event, callback_arg); }
+    }
+}
+
+void esp_microsleep_alert_feed(TaskHandle_t task, esp_microsleep_alert_streak_t* streaks, uint32_t overshoot_us) {
+
+    if (!__atomic_load_n(&esp_microsleep_alerts_used, __ATOMIC_RELAXED)) { return; }
+
+    esp_microsleep_alert_queued_t events[CONFIG_ESP_MICROSLEEP_ALERTS_MAX];
+    size_t pending = 0;
+
+    portENTER_CRITICAL(&esp_microsleep_alerts_lock);
+    for (size_t i = 0; i < CONFIG_ESP_MICROSLEEP_ALERTS_MAX; i++) {
+        struct esp_microsleep_alert* alert = &esp_microsleep_alerts[i];
+        if (!alert->used) { continue; }
+        esp_microsleep_alert_streak_t* streak = &streaks[i];
+        if (streak->generation != alert->generation) {
+            // Left over from an earlier alert in this slot.
+            streak->generation = alert->generation;
+            streak->count = 0;
+        }
+        const bool late = overshoot_us > alert->config.threshold_us;
+        uint32_t triggered = 0;
+        switch (alert->config.kind) {
+            case ESP_MICROSLEEP_ALERT_PERCENTILE:
+                alert->samples++;
+                if (late) { alert->late++; }
+                if (alert->samples >= alert->config.count) {
+                    if (alert->late > alert->config.count * (100 - alert->config.percentile) / 100) { triggered = alert->late; }
+                    alert->samples = 0;
+                    alert->late = 0;
+                }
+                break;
+            case ESP_MICROSLEEP_ALERT_CONSECUTIVE:
+                streak->count = late ? streak->count + 1 : 0;
+                if (streak->count == alert->config.count) { triggered = streak->count; }
+                break;
+        }
+        if (triggered) {
+            events[pending++] = (esp_microsleep_alert_queued_t) {
+                .event = {
+                    .alert = alert,
+                    .kind = alert->config.kind,
+                    .task = task,
+                    .late = triggered,
+                    .overshoot_us = overshoot_us,
+                },
+                .generation = alert->generation,
+            };
+        }
+    }
+    portEXIT_CRITICAL(&esp_microsleep_alerts_lock);
+
+    // Never block the sleeper; if the alert task lags behind, the event is dropped.
+    for (size_t i = 0; i < pending; i++) {
+        xQueueSend(esp_microsleep_alert_queue, &events[i], 0);
+    }
+}
+
+// Creates the queue and the alert task once, even if the first registrations race.
+static esp_err_t esp_microsleep_alert_init() {
+
+    for (;;) {
+        uint32_t state = 0;
+        if (__atomic_compare_exchange_n(&esp_microsleep_alert_init_state, &state, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) { break; }
+        if (state == 2) { return ESP_OK; }
+        // Another task is creating them right now.
+        vTaskDelay(1);
+    }
+
+    QueueHandle_t queue = xQueueCreate(CONFIG_ESP_MICROSLEEP_ALERT_QUEUE_LEN, sizeof(esp_microsleep_alert_queued_t));
+    if (queue) {
+        esp_microsleep_alert_queue = queue;
+        if (xTaskCreate(esp_microsleep_alert_task, "microsleep_alert", CONFIG_ESP_MICROSLEEP_ALERT_TASK_STACK_SIZE, NULL, CONFIG_ESP_MICROSLEEP_ALERT_TASK_PRIORITY, NULL) == pdPASS) {
+            __atomic_store_n(&esp_microsleep_alert_init_state, 2, __ATOMIC_RELEASE);
+            return ESP_OK;
+        }
+        esp_microsleep_alert_queue = NULL;
+        vQueueDelete(queue);
+    }
+    __atomic_store_n(&esp_microsleep_alert_init_state, 0, __ATOMIC_RELEASE);
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_microsleep_alert_register(const esp_microsleep_alert_config_t* config, esp_microsleep_alert_cb_t callback, void* arg, esp_microsleep_alert_handle_t* handle) {
+
+    if (!config || !callback || !config->count) { return ESP_ERR_INVALID_ARG; }
+    if (config->kind == ESP_MICROSLEEP_ALERT_PERCENTILE && (config->percentile < 1 || config->percentile > 99)) { return ESP_ERR_INVALID_ARG; }
+    if (config->kind == ESP_MICROSLEEP_ALERT_CONSECUTIVE && config->count > UINT16_MAX) { return ESP_ERR_INVALID_ARG; }
+
+    const esp_err_t init = esp_microsleep_alert_init();
+    if (init != ESP_OK) { return init; }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&esp_microsleep_alerts_lock);
+    for (size_t i = 0; i < CONFIG_ESP_MICROSLEEP_ALERTS_MAX; i++) {
+        struct esp_microsleep_alert* alert = &esp_microsleep_alerts[i];
+        if (alert->used) { continue; }
+        // A fresh window; the tasks' streaks restart as the generation differs from theirs.
+        *alert = (struct esp_microsleep_alert) {
+            .used = true,
+            .generation = alert->generation,
+            .config = *config,
+            .callback = callback,
+            .arg = arg,
+        };
+        esp_microsleep_alerts_used++;
+        if (handle) { *handle = alert; }
+        err = ESP_OK;
+        break;
+    }
+    portEXIT_CRITICAL(&esp_microsleep_alerts_lock);
+    return err;
+}
+
+esp_err_t esp_microsleep_alert_unregister(esp_microsleep_alert_handle_t handle) {
+
+    if (handle < &esp_microsleep_alerts[0] || handle >= &esp_microsleep_alerts[CONFIG_ESP_MICROSLEEP_ALERTS_MAX]) { return ESP_ERR_INVALID_ARG; }
+
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&esp_microsleep_alerts_lock);
+    if (handle->used) {
+        handle->used = false;
+        handle->generation++;
+        esp_microsleep_alerts_used--;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&esp_microsleep_alerts_lock);
+    return err;
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_ALERTS
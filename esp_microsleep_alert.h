@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_ALERT_H
+#define ESP_MICROSLEEP_ALERT_H
+
+#include "esp_microsleep.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_ALERTS)
+
+/**
+ * @brief Condition an alert watches for.
+ */
+typedef enum {
+    ESP_MICROSLEEP_ALERT_PERCENTILE = 0,   ///< A percentile of the overshoot over a window of delays exceeds the threshold.
+    ESP_MICROSLEEP_ALERT_CONSECUTIVE,      ///< A task overshoots the threshold in a number of consecutive delays.
+} esp_microsleep_alert_kind_t;
+
+/**
+ * @brief Alert configuration.
+ *
+ * For example, "p99 overshoot > 50 µs over 1000 delays" is
+ * `{ .kind = ESP_MICROSLEEP_ALERT_PERCENTILE, .threshold_us = 50, .percentile = 99, .count = 1000 }`,
+ * "5 late wakeups in a row" is
+ * `{ .kind = ESP_MICROSLEEP_ALERT_CONSECUTIVE, .threshold_us = 50, .count = 5 }`.
+ */
+typedef struct {
+    esp_microsleep_alert_kind_t kind;
+    uint32_t threshold_us;   ///< Overshoot of a delay past its deadline considered late.
+    uint8_t percentile;      ///< ESP_MICROSLEEP_ALERT_PERCENTILE: percentile to check, 1-99.
+    uint32_t count;          ///< Window size in delays (all tasks), or number of consecutive late delays (per task).
+} esp_microsleep_alert_config_t;
+
+typedef struct esp_microsleep_alert* esp_microsleep_alert_handle_t;
+
+/**
+ * @brief Details of a triggered alert.
+ */
+typedef struct {
+    esp_microsleep_alert_handle_t alert;   ///< Alert that triggered.
+    esp_microsleep_alert_kind_t kind;      ///< Kind of the alert.
+    TaskHandle_t task;                     ///< Task whose delay triggered the alert.
+    uint32_t late;                         ///< Late delays in the window, or in a row.
+    uint32_t overshoot_us;                 ///< Overshoot of the delay that triggered the alert.
+} esp_microsleep_alert_event_t;
+
+/**
+ * @brief Alert callback.
+ *
+ * Called from a low priority task (CONFIG_ESP_MICROSLEEP_ALERT_TASK_PRIORITY), so it is allowed to block,
+ * log, or shed load.
+ */
+typedef void (*esp_microsleep_alert_cb_t)(const esp_microsleep_alert_event_t* event, void* arg);
+
+/**
+ * @brief Register an alert on the delay overshoot.
+ *
+ * Alerts are evaluated incrementally after every delay, whether it was slept, spun or both. A percentile alert is checked at
+ * the end of every window, a consecutive alert fires once per streak.
+ *
+ * @param[in] config Alert condition.
+ * @param[in] callback Called when the condition is met.
+ * @param[in] arg Argument passed to `callback`.
+ * @param[out] handle Receives the handle of the alert. May be NULL.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid configuration,
+ *         ESP_ERR_NO_MEM if CONFIG_ESP_MICROSLEEP_ALERTS_MAX alerts are registered already
+ *         or the alert task could not be created.
+ */
+esp_err_t esp_microsleep_alert_register(const esp_microsleep_alert_config_t* config, esp_microsleep_alert_cb_t callback, void* arg, esp_microsleep_alert_handle_t* handle);
+
+/**
+ * @brief Unregister an alert.
+ *
+ * @param[in] handle Alert to remove.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown handle.
+ */
+esp_err_t esp_microsleep_alert_unregister(esp_microsleep_alert_handle_t handle);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_ALERTS
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_ALERT_H
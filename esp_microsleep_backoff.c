@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_backoff.h"
+
+#include "esp_random.h"
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+esp_err_t esp_microsleep_backoff_init(esp_microsleep_backoff_t* backoff, uint32_t base_us, uint32_t cap_us, uint8_t jitter_pct, uint32_t max_retries) {
+
+    if (!backoff || !base_us || cap_us < base_us || jitter_pct > 100) { return ESP_ERR_INVALID_ARG; }
+
+    backoff->base_us = base_us;
+    backoff->cap_us = cap_us;
+    backoff->jitter_pct = jitter_pct;
+    backoff->max_retries = max_retries;
+    backoff->attempt = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_microsleep_backoff_wait(esp_microsleep_backoff_t* backoff) {
+
+    if (backoff->max_retries && backoff->attempt >= backoff->max_retries) { return ESP_ERR_TIMEOUT; }
+
+    uint64_t us = backoff->cap_us;
+    if (backoff->attempt < 32) {
+        const uint64_t doubled = (uint64_t) backoff->base_us << backoff->attempt;
+        if (doubled < us) { us = doubled; }
+    }
+    const uint32_t jitter = us * backoff->jitter_pct / 100;
+    if (jitter) { us -= esp_random() % (jitter + 1); }
+    backoff->attempt++;
+    return esp_microsleep_delay(us);
+}
+
+void esp_microsleep_backoff_reset(esp_microsleep_backoff_t* backoff) {
+
+    backoff->attempt = 0;
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_BACKOFF_H
+#define ESP_MICROSLEEP_BACKOFF_H
+
+#include "esp_microsleep.h"
+#include "esp_err.h" // for esp_err_t
+#include "stdint.h" // for uint32_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+/**
+ * @brief State of an exponential backoff, e.g. for retrying a bus transfer.
+ *
+ * Set up with `esp_microsleep_backoff_init`.
+ */
+typedef struct {
+    uint32_t base_us;      ///< Delay before the first retry.
+    uint32_t cap_us;       ///< Upper limit of the delay.
+    uint8_t jitter_pct;    ///< Up to this percentage of each delay is randomly cut off, to spread out competing retries.
+    uint32_t max_retries;  ///< Number of retries before giving up, 0 for unlimited.
+    uint32_t attempt;      ///< Retries so far.
+} esp_microsleep_backoff_t;
+
+/**
+ * @brief Set up an exponential backoff.
+ *
+ * @param[out] backoff The backoff.
+ * @param[in] base_us Delay before the first retry, doubled for each further retry.
+ * @param[in] cap_us Upper limit of the delay.
+ * @param[in] jitter_pct Up to this percentage of each delay is randomly cut off.
+ * @param[in] max_retries Number of retries before giving up, 0 for unlimited.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for invalid arguments.
+ */
+esp_err_t esp_microsleep_backoff_init(esp_microsleep_backoff_t* backoff, uint32_t base_us, uint32_t cap_us, uint8_t jitter_pct, uint32_t max_retries);
+
+/**
+ * @brief Wait before the next retry.
+ *
+ * Waits `base_us * 2^attempt`, at most `cap_us`, minus the jitter.
+ *
+ * @param[inout] backoff The backoff.
+ *
+ * @return ESP_OK when it's time to retry, ESP_ERR_TIMEOUT if the retries are exhausted
+ *         (without waiting) or the deadline scope of the task has expired.
+ */
+esp_err_t esp_microsleep_backoff_wait(esp_microsleep_backoff_t* backoff);
+
+/**
+ * @brief Start over with the base delay, e.g. after a successful transfer.
+ *
+ * @param[inout] backoff The backoff.
+ *
+ * @return None.
+ */
+void esp_microsleep_backoff_reset(esp_microsleep_backoff_t* backoff);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_BACKOFF_H
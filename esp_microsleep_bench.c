@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_bench.h"
+#include "esp_microsleep_private.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_BENCH)
+
+// Set once all sleepers of a run exist, they start together from there.
+#define ESP_MICROSLEEP_BENCH_GO (1 << 0)
+
+static const uint32_t esp_microsleep_bench_periods_us[] = { 100, 250, 500, 1000 };
+static const UBaseType_t esp_microsleep_bench_priorities[] = { 5, 6, 7 };
+
+typedef struct {
+    BaseType_t core;
+    UBaseType_t priority;
+    uint32_t period_us;
+    uint64_t start_us;
+    uint64_t end_us;
+    uint32_t delays;
+    int64_t overshoot_sum;
+    int32_t overshoot_min;
+    int32_t overshoot_max;
+} esp_microsleep_bench_sleeper_t;
+
+static SemaphoreHandle_t esp_microsleep_bench_done = NULL;  // given by each sleeper on exit
+static EventGroupHandle_t esp_microsleep_bench_barrier = NULL;
+static portMUX_TYPE esp_microsleep_bench_isr_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t esp_microsleep_bench_isr_count = 0;
+static uint64_t esp_microsleep_bench_isr_cycles = 0;
+static uint32_t esp_microsleep_bench_isr_max = 0;
+
+void IRAM_ATTR esp_microsleep_bench_isr(uint32_t cycles) {
+
+    portENTER_CRITICAL_ISR(&esp_microsleep_bench_isr_lock);
+    esp_microsleep_bench_isr_count++;
+    esp_microsleep_bench_isr_cycles += cycles;
+    if (cycles > esp_microsleep_bench_isr_max) { esp_microsleep_bench_isr_max = cycles; }
+    portEXIT_CRITICAL_ISR(&esp_microsleep_bench_isr_lock);
+}
+
+static void esp_microsleep_bench_task(void* arg) {
+
+    esp_microsleep_bench_sleeper_t* sleeper = (esp_microsleep_bench_sleeper_t*) arg;
+    xEventGroupWaitBits(esp_microsleep_bench_barrier, ESP_MICROSLEEP_BENCH_GO, pdFALSE, pdTRUE, portMAX_DELAY);
+    // The first period absorbs how long the sleepers sharing a core took to get going, it is not measured.
+    uint64_t due = sleeper->start_us + sleeper->period_us;
+    if (due <= sleeper->end_us) { esp_microsleep_delay_until(due); }
+    for (due += sleeper->period_us; due <= sleeper->end_us; due += sleeper->period_us) {
+        esp_microsleep_delay_until(due);
+        const int32_t overshoot = (int32_t)(esp_timer_get_time() - (int64_t) due);
+        if (overshoot < sleeper->overshoot_min) { sleeper->overshoot_min = overshoot; }
+        if (overshoot > sleeper->overshoot_max) { sleeper->overshoot_max = overshoot; }
+        sleeper->overshoot_sum += overshoot;
+        sleeper->delays++;
+    }
+    xSemaphoreGive(esp_microsleep_bench_done);
+    vTaskDelete(NULL);
+}
+
+#ifdef CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static configRUN_TIME_COUNTER_TYPE esp_microsleep_bench_idle_time() {
+
+    configRUN_TIME_COUNTER_TYPE idle = 0;
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+        idle += ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+    return idle;
+}
+#endif
+
+static esp_err_t esp_microsleep_bench_run(esp_microsleep_bench_sleeper_t* sleepers, uint8_t n, uint32_t duration_ms, FILE* out) {
+
+    for (uint8_t i = 0; i < n; i++) {
+        esp_microsleep_bench_sleeper_t* sleeper = &sleepers[i];
+        sleeper->core = i % portNUM_PROCESSORS;
+        sleeper->priority = esp_microsleep_bench_priorities[i % (sizeof(esp_microsleep_bench_priorities) / sizeof(esp_microsleep_bench_priorities[0]))];
+        sleeper->period_us = esp_microsleep_bench_periods_us[i % (sizeof(esp_microsleep_bench_periods_us) / sizeof(esp_microsleep_bench_periods_us[0]))];
+        sleeper->delays = 0;
+        sleeper->overshoot_sum = 0;
+        sleeper->overshoot_min = INT32_MAX;
+        sleeper->overshoot_max = INT32_MIN;
+    }
+
+    xEventGroupClearBits(esp_microsleep_bench_barrier, ESP_MICROSLEEP_BENCH_GO);
+    uint8_t spawned = 0;
+    for (; spawned < n; spawned++) {
+        esp_microsleep_bench_sleeper_t* sleeper = &sleepers[spawned];
+        if (xTaskCreatePinnedToCore(esp_microsleep_bench_task, "microsleep_bench", CONFIG_ESP_MICROSLEEP_BENCH_TASK_STACK_SIZE,
+                                    sleeper, sleeper->priority, NULL, sleeper->core) != pdPASS) { break; }
+    }
+
+    // The sleepers read their schedule once released. An incomplete run releases them with nothing to do.
+    const uint64_t start = esp_timer_get_time();
+    for (uint8_t i = 0; i < spawned; i++) {
+        sleepers[i].start_us = start;
+        sleepers[i].end_us = spawned < n ? start : start + (uint64_t) duration_ms * 1000;
+    }
+    xEventGroupSetBits(esp_microsleep_bench_barrier, ESP_MICROSLEEP_BENCH_GO);
+    portENTER_CRITICAL(&esp_microsleep_bench_isr_lock);
+    esp_microsleep_bench_isr_count = 0;
+    esp_microsleep_bench_isr_cycles = 0;
+    esp_microsleep_bench_isr_max = 0;
+    portEXIT_CRITICAL(&esp_microsleep_bench_isr_lock);
+#ifdef CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    const configRUN_TIME_COUNTER_TYPE idle_start = esp_microsleep_bench_idle_time();
+    const configRUN_TIME_COUNTER_TYPE total_start = portGET_RUN_TIME_COUNTER_VALUE();
+#endif
+
+    for (uint8_t i = 0; i < spawned; i++) {
+        xSemaphoreTake(esp_microsleep_bench_done, portMAX_DELAY);
+    }
+    if (spawned < n) { return ESP_ERR_NO_MEM; }
+
+#ifdef CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    const uint64_t idle = esp_microsleep_bench_idle_time() - idle_start;
+    const uint64_t total = (uint64_t)(portGET_RUN_TIME_COUNTER_VALUE() - total_start) * portNUM_PROCESSORS;
+#endif
+    portENTER_CRITICAL(&esp_microsleep_bench_isr_lock);
+    const uint32_t isr_count = esp_microsleep_bench_isr_count;
+    const uint64_t isr_cycles = esp_microsleep_bench_isr_cycles;
+    const uint32_t isr_max = esp_microsleep_bench_isr_max;
+    portEXIT_CRITICAL(&esp_microsleep_bench_isr_lock);
+
+    uint32_t delays = 0;
+    int64_t overshoot_sum = 0;
+    int32_t overshoot_min = INT32_MAX, overshoot_max = INT32_MIN;
+    for (uint8_t i = 0; i < n; i++) {
+        const esp_microsleep_bench_sleeper_t* sleeper = &sleepers[i];
+        if (!sleeper->delays) { continue; }
+        fprintf(out, "task,%u,%u,%d,%u,%" PRIu32 ",%" PRIu32 ",%" PRId32 ",%" PRId64 ",%" PRId32 ",,,,\n", n, i, (int) sleeper->core,
+                (unsigned) sleeper->priority, sleeper->period_us, sleeper->delays, sleeper->overshoot_min,
+                sleeper->overshoot_sum / sleeper->delays, sleeper->overshoot_max);
+        delays += sleeper->delays;
+        overshoot_sum += sleeper->overshoot_sum;
+        if (sleeper->overshoot_min < overshoot_min) { overshoot_min = sleeper->overshoot_min; }
+        if (sleeper->overshoot_max > overshoot_max) { overshoot_max = sleeper->overshoot_max; }
+    }
+    if (!delays) { return ESP_OK; }
+
+    fprintf(out, "run,%u,,,,,%" PRIu32 ",%" PRId32 ",%" PRId64 ",%" PRId32 ",%" PRIu32 ",%" PRIu64 ",%" PRIu32 ",", n, delays, overshoot_min,
+            overshoot_sum / delays, overshoot_max, isr_count, isr_count ? isr_cycles / isr_count : 0, isr_max);
+#ifdef CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    if (total) {
+        const uint64_t busy_permille = idle < total ? (total - idle) * 1000 / total : 0;
+        fprintf(out, "%" PRIu64 ".%" PRIu64, busy_permille / 10, busy_permille % 10);
+    }
+#endif
+    fprintf(out, "\n");
+    return ESP_OK;
+}
+
+esp_err_t esp_microsleep_bench_scaling(uint8_t max_tasks, uint32_t duration_ms, FILE* out) {
+
+    if (!max_tasks || max_tasks > ESP_MICROSLEEP_BENCH_TASKS_MAX || !duration_ms || !out) { return ESP_ERR_INVALID_ARG; }
+
+    if (!esp_microsleep_bench_done) {
+        esp_microsleep_bench_barrier = xEventGroupCreate();
+        if (!esp_microsleep_bench_barrier) { return ESP_ERR_NO_MEM; }
+        esp_microsleep_bench_done = xSemaphoreCreateCounting(ESP_MICROSLEEP_BENCH_TASKS_MAX, 0);
+        if (!esp_microsleep_bench_done) {
+            vEventGroupDelete(esp_microsleep_bench_barrier);
+            esp_microsleep_bench_barrier = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    esp_microsleep_bench_sleeper_t* sleepers = calloc(max_tasks, sizeof(esp_microsleep_bench_sleeper_t));
+    if (!sleepers) { return ESP_ERR_NO_MEM; }
+
+    fprintf(out, "kind,tasks,task,core,priority,period_us,delays,overshoot_min_us,overshoot_avg_us,overshoot_max_us,"
+                 "isr_count,isr_avg_cycles,isr_max_cycles,cpu_busy_pct\n");
+    esp_err_t err = ESP_OK;
+    for (unsigned n = 1; err == ESP_OK; n *= 2) {
+        if (n > max_tasks) { n = max_tasks; }
+        err = esp_microsleep_bench_run(sleepers, (uint8_t) n, duration_ms, out);
+        if (n == max_tasks) { break; }
+    }
+    free(sleepers);
+    return err;
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_BENCH
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_BENCH_H
+#define ESP_MICROSLEEP_BENCH_H
+
+#include "esp_microsleep.h"
+#include "esp_err.h" // for esp_err_t
+#include "stdint.h" // for uint8_t, uint32_t
+#include "stdio.h" // for FILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_BENCH)
+
+/**
+ * @brief Upper limit of concurrent sleepers in `esp_microsleep_bench_scaling`.
+ */
+#define ESP_MICROSLEEP_BENCH_TASKS_MAX 64
+
+/**
+ * @brief Measure how delay accuracy and overhead scale with the number of concurrent sleepers.
+ *
+ * Runs with 1, 2, 4, ... up to `max_tasks` sleeper tasks, each for `duration_ms`. Sleeper `i`
+ * is pinned to core `i % portNUM_PROCESSORS` and calls `esp_microsleep_delay_until` periodically;
+ * periods (100 to 1000 µs) and priorities (5 to 7) are mixed in a fixed pattern, so runs
+ * are comparable across builds. The sleepers of a run start together once all of them exist;
+ * the first period of each is not measured.
+ *
+ * Writes CSV with a header line, then per run one `task` row per sleeper with its overshoot,
+ * and one `run` row with the overall overshoot, the number and CPU cycles of the wakeup timer
+ * callbacks, and the percentage of CPU time not spent idle. The latter is empty
+ * without `CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS`.
+ *
+ * Start the synthetic load (see `esp_microsleep_load.h`) before to benchmark under load.
+ *
+ * @param[in] max_tasks Largest number of sleepers, 1 to `ESP_MICROSLEEP_BENCH_TASKS_MAX`.
+ * @param[in] duration_ms Duration of each run.
+ * @param[in] out Where to write the CSV.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for invalid arguments, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t esp_microsleep_bench_scaling(uint8_t max_tasks, uint32_t duration_ms, FILE* out);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_BENCH
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_BENCH_H
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_compensation.h"
+
+#include <string.h>
+
+// Samples needed before the linear fit is trusted.
+#define ESP_MICROSLEEP_COMPENSATION_FIT_MIN 8
+// Longer sleeps are fitted as if they were this long, which keeps the fixed point math within 64 bits.
+#define ESP_MICROSLEEP_COMPENSATION_FIT_MAX_US 100000
+
+void esp_microsleep_compensation_init(esp_microsleep_compensation_t* state, uint8_t percentile) {
+
+    memset(state, 0, sizeof(*state));
+    state->percentile = percentile ? (percentile > 100 ? 100 : percentile) : 1;
+}
+
+void esp_microsleep_compensation_observe(esp_microsleep_compensation_t* state, uint64_t requested_us, uint32_t latency_us) {
+
+    const uint16_t latency = latency_us > UINT16_MAX ? UINT16_MAX : (uint16_t) latency_us;
+
+    // Keep the sorted copy in step with the ring buffer: drop the latency about to be overwritten, insert the new one.
+    uint8_t count = state->filled;
+    if (count == ESP_MICROSLEEP_COMPENSATION_HISTORY) {
+        const uint16_t evicted = state->history[state->next];
+        uint8_t i = 0;
+        while (state->sorted[i] != evicted) { i++; }
+        memmove(&state->sorted[i], &state->sorted[i + 1], (--count - i) * sizeof(state->sorted[0]));
+    }
+    uint8_t j = count;
+    for (; j > 0 && state->sorted[j - 1] > latency; j--) { state->sorted[j] = state->sorted[j - 1]; }
+    state->sorted[j] = latency;
+
+    state->history[state->next] = latency;
+    state->next = (state->next + 1) % ESP_MICROSLEEP_COMPENSATION_HISTORY;
+    if (state->filled < ESP_MICROSLEEP_COMPENSATION_HISTORY) {
+        state->filled++;
+        state->avg16 = state->filled == 1 ? latency * 16 : state->avg16 + (latency * 16 - state->avg16) / 8;
+    } else {
+        state->avg16 += (latency * 16 - state->avg16) / 8;
+    }
+
+    const int64_t x = requested_us > ESP_MICROSLEEP_COMPENSATION_FIT_MAX_US ? ESP_MICROSLEEP_COMPENSATION_FIT_MAX_US : (int64_t) requested_us;
+    const int64_t y = latency;
+    if (state->filled == 1) {
+        state->x16 = x * 16;
+        state->y16 = y * 16;
+        state->xx16 = x * x * 16;
+        state->xy16 = x * y * 16;
+    } else {
+        state->x16 += (x * 16 - state->x16) / 16;
+        state->y16 += (y * 16 - state->y16) / 16;
+        state->xx16 += (x * x * 16 - state->xx16) / 16;
+        state->xy16 += (x * y * 16 - state->xy16) / 16;
+    }
+}
+
+uint32_t esp_microsleep_compensation_get(const esp_microsleep_compensation_t* state, esp_microsleep_compensation_policy_t policy, uint32_t calibrated_us, uint64_t requested_us) {
+
+    switch (policy) {
+        case ESP_MICROSLEEP_COMPENSATION_MEAN:
+            break;
+        case ESP_MICROSLEEP_COMPENSATION_PERCENTILE:
+            if (state->filled) { return state->sorted[(state->filled - 1) * state->percentile / 100]; }
+            break;
+        case ESP_MICROSLEEP_COMPENSATION_ADAPTIVE:
+            if (state->filled) { return state->avg16 / 16; }
+            break;
+        case ESP_MICROSLEEP_COMPENSATION_DURATION: {
+            if (state->filled < ESP_MICROSLEEP_COMPENSATION_FIT_MIN) { break; }
+            // Least squares fit y = E[y] + cov(x, y) / var(x) * (x - E[x]); both cov and var are scaled by 256 here.
+            const int64_t var = state->xx16 * 16 - state->x16 * state->x16;
+            const int64_t cov = state->xy16 * 16 - state->x16 * state->y16;
+            const int64_t x = requested_us > ESP_MICROSLEEP_COMPENSATION_FIT_MAX_US ? ESP_MICROSLEEP_COMPENSATION_FIT_MAX_US : (int64_t) requested_us;
+            int64_t y16 = state->y16;
+            if (var > 0) { y16 += cov * (x * 16 - state->x16) / var; }
+            return y16 > 0 ? (uint32_t)(y16 / 16) : 0;
+        }
+    }
+    return calibrated_us;
+}
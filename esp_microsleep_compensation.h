@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_COMPENSATION_H
+#define ESP_MICROSLEEP_COMPENSATION_H
+
+// Compensation policies, i.e. how much earlier than requested a timer sleep is ended to
+// make up for the wakeup latency. Plain C without ESP-IDF dependencies, so that the very
+// same code runs on the device and in tools/compensation_replay.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_MICROSLEEP_COMPENSATION_HISTORY 32
+
+/**
+ * @brief How the compensation of a timer sleep is determined.
+ */
+typedef enum {
+    ESP_MICROSLEEP_COMPENSATION_MEAN = 0,     ///< Mean latency measured by `esp_microsleep_calibrate`. Default.
+    ESP_MICROSLEEP_COMPENSATION_PERCENTILE,   ///< Percentile of the task's recent latencies; fewer late, more early wakeups.
+    ESP_MICROSLEEP_COMPENSATION_ADAPTIVE,     ///< Moving average of the task's latencies, follows changes of the load.
+    ESP_MICROSLEEP_COMPENSATION_DURATION,     ///< Latency as a linear function of the sleep duration, fitted per task.
+} esp_microsleep_compensation_policy_t;
+
+/**
+ * @brief Latency history of a task, shared by all policies. The members are private.
+ */
+typedef struct {
+    uint8_t percentile;                                     // for ESP_MICROSLEEP_COMPENSATION_PERCENTILE
+    uint8_t next;                                           // ring buffer position in history
+    uint8_t filled;                                         // valid entries in history
+    uint16_t history[ESP_MICROSLEEP_COMPENSATION_HISTORY];  // recent latencies, µs
+    uint16_t sorted[ESP_MICROSLEEP_COMPENSATION_HISTORY];   // the valid entries of history in ascending order
+    int32_t avg16;                                          // moving average of the latency, 1/16 µs
+    int64_t x16, y16, xx16, xy16;                           // moving moments of requested duration x and latency y, times 16
+} esp_microsleep_compensation_t;
+
+/**
+ * @brief Reset the latency history.
+ *
+ * @param[out] state The history.
+ * @param[in] percentile Percentile used by ESP_MICROSLEEP_COMPENSATION_PERCENTILE, 1-100.
+ */
+void esp_microsleep_compensation_init(esp_microsleep_compensation_t* state, uint8_t percentile);
+
+/**
+ * @brief Feed the latency of a finished timer sleep into the history.
+ *
+ * @param[inout] state The history.
+ * @param[in] requested_us Requested duration of the delay the sleep was part of, the same value
+ *                         `esp_microsleep_compensation_get` is asked for.
+ * @param[in] latency_us How much later than the timer was armed for the task was running again.
+ */
+void esp_microsleep_compensation_observe(esp_microsleep_compensation_t* state, uint64_t requested_us, uint32_t latency_us);
+
+/**
+ * @brief Compute the compensation of a delay.
+ *
+ * Policies relying on the history fall back to `calibrated_us` until enough latencies have been observed.
+ *
+ * @param[in] state The history.
+ * @param[in] policy The policy.
+ * @param[in] calibrated_us Mean latency as measured by `esp_microsleep_calibrate`.
+ * @param[in] requested_us Requested duration of the delay.
+ *
+ * @return Compensation in microseconds.
+ */
+uint32_t esp_microsleep_compensation_get(const esp_microsleep_compensation_t* state, esp_microsleep_compensation_policy_t policy, uint32_t calibrated_us, uint64_t requested_us);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_COMPENSATION_H
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_console.h"
+#include "esp_microsleep_load.h"
+#include "esp_microsleep_bench.h"
+#include "esp_microsleep_profile.h"
+
+#ifdef CONFIG_ESP_MICROSLEEP_CONSOLE
+#include "esp_console.h"
+#endif
+#include "esp_timer.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_CONSOLE)
+
+static const char* const esp_microsleep_mode_names[] = {
+    [ESP_MICROSLEEP_STRATEGY_SLEEP] = "sleep",
+    [ESP_MICROSLEEP_STRATEGY_HYBRID] = "hybrid",
+    [ESP_MICROSLEEP_STRATEGY_SPIN] = "spin",
+};
+
+// Resolves the optional trailing domain argument, NULL selects the default domain.
+static bool esp_microsleep_console_domain(const char* name, esp_microsleep_domain_handle_t* domain) {
+
+    *domain = name ? esp_microsleep_domain_find(name) : NULL;
+    if (name && !*domain) {
+        printf("unknown domain '%s'\n", name);
+        return false;
+    }
+    return true;
+}
+
+static const char* const esp_microsleep_policy_names[] = {
+    [ESP_MICROSLEEP_COMPENSATION_MEAN] = "mean",
+    [ESP_MICROSLEEP_COMPENSATION_PERCENTILE] = "percentile",
+    [ESP_MICROSLEEP_COMPENSATION_ADAPTIVE] = "adaptive",
+    [ESP_MICROSLEEP_COMPENSATION_DURATION] = "duration",
+};
+
+static int esp_microsleep_console_stats(esp_microsleep_domain_handle_t domain) {
+
+    esp_microsleep_config_t config;
+    esp_microsleep_domain_get_config(domain, &config);
+    esp_microsleep_stats_t stats;
+    esp_microsleep_domain_get_stats(domain, &stats);
+    printf("domain:              %s\n", esp_microsleep_domain_get_name(domain));
+    printf("compensation:        %" PRIu64 " us%s\n", esp_microsleep_domain_get_compensation(domain), config.compensation_override ? " (override)" : "");
+    printf("policy:              %s\n", esp_microsleep_policy_names[config.policy]);
+    printf("spin threshold:      %" PRIu32 " us\n", config.spin_threshold_us);
+    printf("mode:                %s\n", esp_microsleep_mode_names[config.mode]);
+    printf("stats:               %s\n", config.stats_enabled ? "on" : "off");
+    printf("delays:              %" PRIu32 "\n", stats.delays);
+    printf("wakeups:             %" PRIu32 " (%" PRIu32 " yields)\n", stats.wakeups, stats.wakeup_yields);
+    printf("strategy sleep:      %" PRIu32 "\n", stats.strategy_sleep);
+    printf("strategy hybrid:     %" PRIu32 "\n", stats.strategy_hybrid);
+    printf("strategy spin:       %" PRIu32 "\n", stats.strategy_spin);
+    printf("bursts:              %" PRIu32 " (%" PRIu32 " spins)\n", stats.bursts, stats.burst_spins);
+    printf("warm-up overruns:    %" PRIu32 "\n", stats.warmup_overruns);
+    printf("late wakeups:        %" PRIu32 " (%" PRIu32 " unattributed)\n", stats.late_wakeups, stats.late_wakeups_unattributed);
+    printf("critical spins:      %" PRIu32 " (%" PRIu32 " cap hits, %" PRIu32 " late)\n", stats.critical_spins, stats.critical_spin_cap_hits, stats.critical_spin_late);
+
+    char* table = malloc(CONFIG_ESP_MICROSLEEP_TASK_STATS_MAX * 80);
+    if (table) {
+        esp_microsleep_get_task_stats_table(table, CONFIG_ESP_MICROSLEEP_TASK_STATS_MAX * 80);
+        printf("\n%s", table);
+        free(table);
+    }
+
+#ifdef CONFIG_ESP_MICROSLEEP_CULPRITS
+    esp_microsleep_culprit_t culprits[CONFIG_ESP_MICROSLEEP_CULPRITS_MAX];
+    size_t count = esp_microsleep_get_culprits(culprits, CONFIG_ESP_MICROSLEEP_CULPRITS_MAX);
+    if (count) {
+        printf("\n%-*s %10s %10s\n", configMAX_TASK_NAME_LEN, "Culprit", "Late", "IRQ masked");
+        for (size_t i = 0; i < count; i++) {
+            printf("%-*s %10" PRIu32 " %10" PRIu32 "\n", configMAX_TASK_NAME_LEN, culprits[i].name, culprits[i].count, culprits[i].irq_masked);
+        }
+    }
+#endif
+    return 0;
+}
+
+static int esp_microsleep_console_set(int argc, char** argv) {
+
+    if (argc != 2 && argc != 3) { return 1; }
+    esp_microsleep_domain_handle_t domain;
+    if (!esp_microsleep_console_domain(argc == 3 ? argv[2] : NULL, &domain)) { return 1; }
+
+    esp_microsleep_config_t config;
+    esp_microsleep_domain_get_config(domain, &config);
+
+    if (!strcmp(argv[0], "compensation") || !strcmp(argv[0], "spin")) {
+        if (!strcmp(argv[0], "compensation") && !strcmp(argv[1], "auto")) {
+            config.compensation_override = false;
+            return esp_microsleep_domain_set_config(domain, &config) == ESP_OK ? 0 : 1;
+        }
+        char* end;
+        const unsigned long us = strtoul(argv[1], &end, 10);
+        if (*end) { return 1; }
+        if (!strcmp(argv[0], "spin")) {
+            config.spin_threshold_us = us;
+        } else {
+            config.compensation_override = true;
+            config.compensation_us = us;
+        }
+        return esp_microsleep_domain_set_config(domain, &config) == ESP_OK ? 0 : 1;
+    }
+    if (!strcmp(argv[0], "mode")) {
+        for (size_t i = 0; i < sizeof(esp_microsleep_mode_names) / sizeof(esp_microsleep_mode_names[0]); i++) {
+            if (!strcmp(argv[1], esp_microsleep_mode_names[i])) {
+                config.mode = (esp_microsleep_strategy_t) i;
+                return esp_microsleep_domain_set_config(domain, &config) == ESP_OK ? 0 : 1;
+            }
+        }
+    }
+    if (!strcmp(argv[0], "policy")) {
+        for (size_t i = 0; i < sizeof(esp_microsleep_policy_names) / sizeof(esp_microsleep_policy_names[0]); i++) {
+            if (!strcmp(argv[1], esp_microsleep_policy_names[i])) {
+                config.policy = (esp_microsleep_compensation_policy_t) i;
+                return esp_microsleep_domain_set_config(domain, &config) == ESP_OK ? 0 : 1;
+            }
+        }
+    }
+    if (!strcmp(argv[0], "stats") && (!strcmp(argv[1], "on") || !strcmp(argv[1], "off"))) {
+        config.stats_enabled = !strcmp(argv[1], "on");
+        return esp_microsleep_domain_set_config(domain, &config) == ESP_OK ? 0 : 1;
+    }
+    return 1;
+}
+
+static int esp_microsleep_console_bench(int argc, char** argv) {
+
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+    if (argc == 3 && !strcmp(argv[0], "scale")) {
+        const unsigned long tasks = strtoul(argv[1], NULL, 10);
+        const uint32_t ms = strtoul(argv[2], NULL, 10);
+        if (!tasks || tasks > ESP_MICROSLEEP_BENCH_TASKS_MAX || !ms) { return 1; }
+        const esp_err_t err = esp_microsleep_bench_scaling(tasks, ms, stdout);
+        if (err != ESP_OK) { printf("bench: %s\n", esp_err_to_name(err)); }
+        return 0;
+    }
+#endif
+    if (argc != 2) { return 1; }
+    const uint64_t us = strtoull(argv[0], NULL, 10);
+    const uint32_t n = strtoul(argv[1], NULL, 10);
+    if (!us || !n) { return 1; }
+
+    int64_t min = INT64_MAX, max = INT64_MIN, sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const int64_t start = esp_timer_get_time();
+        esp_microsleep_delay(us);
+        const int64_t overshoot = esp_timer_get_time() - start - (int64_t) us;
+        if (overshoot < min) { min = overshoot; }
+        if (overshoot > max) { max = overshoot; }
+        sum += overshoot;
+    }
+    printf("%" PRIu32 " x %" PRIu64 " us: overshoot min %" PRId64 " us, avg %" PRId64 " us, max %" PRId64 " us\n", n, us, min, sum / n, max);
+    return 0;
+}
+
+#ifdef CONFIG_ESP_MICROSLEEP_LOAD
+static int esp_microsleep_console_load(int argc, char** argv) {
+
+    if (argc != 1) { return 1; }
+    esp_err_t err;
+    if (!strcmp(argv[0], "on")) {
+        const esp_microsleep_load_config_t typical = ESP_MICROSLEEP_LOAD_TYPICAL;
+        err = esp_microsleep_load_start(&typical);
+    } else if (!strcmp(argv[0], "off")) {
+        err = esp_microsleep_load_stop();
+    } else {
+        return 1;
+    }
+    if (err != ESP_OK) { printf("load: %s\n", esp_err_to_name(err)); }
+    return 0;
+}
+#endif
+
+#ifdef CONFIG_ESP_MICROSLEEP_PROFILE
+static int esp_microsleep_console_profile(int argc, char** argv) {
+
+    if (argc == 0) {
+        esp_microsleep_profile_print(stdout);
+    } else if (argc == 1 && !strcmp(argv[0], "reset")) {
+        esp_microsleep_profile_reset();
+    } else if (argc == 2 && !strcmp(argv[0], "primitives")) {
+        const uint32_t n = strtoul(argv[1], NULL, 10);
+        if (!n) { return 1; }
+        const esp_err_t err = esp_microsleep_profile_primitives(n, stdout);
+        if (err != ESP_OK) { printf("profile: %s\n", esp_err_to_name(err)); }
+    } else {
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+static int esp_microsleep_console_command(int argc, char** argv) {
+
+    int result = 1;
+    esp_microsleep_domain_handle_t domain;
+    if (argc >= 2) {
+        const char* command = argv[1];
+        if (!strcmp(command, "stats") && argc <= 3) {
+            if (esp_microsleep_console_domain(argc == 3 ? argv[2] : NULL, &domain)) {
+                result = esp_microsleep_console_stats(domain);
+            }
+        } else if (!strcmp(command, "reset") && argc <= 3) {
+            if (esp_microsleep_console_domain(argc == 3 ? argv[2] : NULL, &domain)) {
+                esp_microsleep_domain_reset_stats(domain);
+                result = 0;
+            }
+        } else if (!strcmp(command, "calibrate") && argc == 2) {
+            printf("compensation: %" PRIu64 " us\n", esp_microsleep_calibrate());
+            result = 0;
+        } else if (!strcmp(command, "set")) {
+            result = esp_microsleep_console_set(argc - 2, argv + 2);
+        } else if (!strcmp(command, "bench")) {
+            result = esp_microsleep_console_bench(argc - 2, argv + 2);
+#ifdef CONFIG_ESP_MICROSLEEP_LOAD
+        } else if (!strcmp(command, "load")) {
+            result = esp_microsleep_console_load(argc - 2, argv + 2);
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_PROFILE
+        } else if (!strcmp(command, "profile")) {
+            result = esp_microsleep_console_profile(argc - 2, argv + 2);
+#endif
+        }
+    }
+    if (result) {
+        printf("usage: microsleep stats|reset [domain]\n"
+               "       microsleep calibrate\n"
+               "       microsleep set compensation <us>|auto [domain]\n"
+               "       microsleep set spin <us> [domain]\n"
+               "       microsleep set mode sleep|hybrid|spin [domain]\n"
+               "       microsleep set policy mean|percentile|adaptive|duration [domain]\n"
+               "       microsleep set stats on|off [domain]\n"
+               "       microsleep bench <us> <n>\n");
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+        printf("       microsleep bench scale <max tasks> <ms>\n");
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_LOAD
+        printf("       microsleep load on|off\n");
+#endif
+#ifdef CONFIG_ESP_MICROSLEEP_PROFILE
+        printf("       microsleep profile [reset|primitives <n>]\n");
+#endif
+    }
+    return result;
+}
+
+esp_err_t esp_microsleep_console_register() {
+
+    const esp_console_cmd_t command = {
+        .command = "microsleep",
+        .help = "Inspect and tune esp_microsleep",
+        .hint = "stats|reset|calibrate|set|bench|load|profile ...",
+        .func = esp_microsleep_console_command,
+    };
+    return esp_console_cmd_register(&command);
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_CONSOLE
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_CONSOLE_H
+#define ESP_MICROSLEEP_CONSOLE_H
+
+#include "esp_microsleep.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_CONSOLE)
+
+/**
+ * @brief Register the `microsleep` console command.
+ *
+ * Call this after `esp_console_init` or `esp_console_new_repl_*`. Subcommands:
+ *
+ *     microsleep stats [domain]                    Show the statistics of a domain (default: the default domain) and its tasks.
+ *     microsleep reset [domain]                    Reset the statistics.
+ *     microsleep calibrate                         Recompute the compensation value.
+ *     microsleep set compensation <us>|auto [domain]  Override the compensation value, or go back to the calibrated one.
+ *     microsleep set spin <us> [domain]            Set the spin threshold.
+ *     microsleep set mode sleep|hybrid|spin [domain]  Set the strategy for tasks without an SLA.
+ *     microsleep set policy mean|percentile|adaptive|duration [domain]  Set the compensation policy.
+ *     microsleep set stats on|off [domain]         Enable or disable the statistics.
+ *     microsleep bench <us> <n>                    Measure the overshoot of n delays of us microseconds.
+ *     microsleep bench scale <max tasks> <ms>      Run the scaling benchmark (CONFIG_ESP_MICROSLEEP_BENCH).
+ *     microsleep load on|off                       Start or stop the typical synthetic load (CONFIG_ESP_MICROSLEEP_LOAD).
+ *     microsleep profile [reset|primitives <n>]    Show or reset the hot path cycle counts, or measure
+ *                                                  the primitives (CONFIG_ESP_MICROSLEEP_PROFILE).
+ *
+ * @return ESP_OK on success, otherwise the error of `esp_console_cmd_register`.
+ */
+esp_err_t esp_microsleep_console_register();
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_CONSOLE
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_CONSOLE_H
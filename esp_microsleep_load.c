@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_load.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "rom/ets_sys.h"
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_LOAD)
+
+// Stride of the cache pressure reads, the smallest flash cache line size of the supported chips.
+#define ESP_MICROSLEEP_LOAD_CACHE_LINE 32
+
+// Lives in flash, as it's const and not all zero.
+static const uint32_t esp_microsleep_load_flash[CONFIG_ESP_MICROSLEEP_LOAD_FLASH_KB * 1024 / sizeof(uint32_t)] = { 1 };
+
+static esp_microsleep_load_config_t esp_microsleep_load_config;
+static SemaphoreHandle_t esp_microsleep_load_done = NULL;  // given by each load task on exit
+static esp_timer_handle_t esp_microsleep_load_timer = NULL;
+static portMUX_TYPE esp_microsleep_load_lock = portMUX_INITIALIZER_UNLOCKED;  // contended across the cores
+static volatile uint32_t esp_microsleep_load_shared = 0;
+static bool esp_microsleep_load_running = false;
+static UBaseType_t esp_microsleep_load_tasks = 0;
+
+static inline bool esp_microsleep_load_active() {
+
+    return __atomic_load_n(&esp_microsleep_load_running, __ATOMIC_RELAXED);
+}
+
+static void esp_microsleep_load_exit() {
+
+    xSemaphoreGive(esp_microsleep_load_done);
+    vTaskDelete(NULL);
+}
+
+static void esp_microsleep_load_hog_task(void* arg) {
+
+    const esp_microsleep_load_hog_t* hog = (const esp_microsleep_load_hog_t*) arg;
+    TickType_t period = pdMS_TO_TICKS(hog->period_ms);
+    if (hog->period_ms && !period) { period = 1; }
+
+    TickType_t wake = xTaskGetTickCount();
+    while (esp_microsleep_load_active()) {
+        ets_delay_us(hog->busy_us);
+        if (period) {
+            xTaskDelayUntil(&wake, period);
+        } else {
+            taskYIELD();
+        }
+    }
+    esp_microsleep_load_exit();
+}
+
+static void IRAM_ATTR esp_microsleep_load_isr(void* arg) {
+
+    ets_delay_us(esp_microsleep_load_config.isr_busy_us);
+}
+
+static void esp_microsleep_load_contention_task(void* arg) {
+
+    // Bounce the lock with the other core for a millisecond, then give lower priorities a tick.
+    while (esp_microsleep_load_active()) {
+        const int64_t until = esp_timer_get_time() + 1000;
+        while (esp_timer_get_time() < until) {
+            portENTER_CRITICAL(&esp_microsleep_load_lock);
+            esp_microsleep_load_shared++;
+            ets_delay_us(esp_microsleep_load_config.contention_hold_us);
+            portEXIT_CRITICAL(&esp_microsleep_load_lock);
+        }
+        vTaskDelay(1);
+    }
+    esp_microsleep_load_exit();
+}
+
+static void esp_microsleep_load_cache_task(void* arg) {
+
+    const volatile uint32_t* table = esp_microsleep_load_flash;
+    const size_t stride = ESP_MICROSLEEP_LOAD_CACHE_LINE / sizeof(uint32_t);
+    uint32_t sum = 0;
+    while (esp_microsleep_load_active()) {
+        for (size_t i = 0; i < sizeof(esp_microsleep_load_flash) / sizeof(uint32_t); i += stride) {
+            sum += table[i];
+        }
+        vTaskDelay(1);
+    }
+    (void) sum;
+    esp_microsleep_load_exit();
+}
+
+static bool esp_microsleep_load_spawn(TaskFunction_t task, const char* name, void* arg, UBaseType_t priority, BaseType_t core) {
+
+    if (xTaskCreatePinnedToCore(task, name, CONFIG_ESP_MICROSLEEP_LOAD_TASK_STACK_SIZE, arg, priority, NULL, core) != pdPASS) { return false; }
+    esp_microsleep_load_tasks++;
+    return true;
+}
+
+static bool esp_microsleep_load_valid(const esp_microsleep_load_config_t* config) {
+
+    for (int i = 0; i < CONFIG_ESP_MICROSLEEP_LOAD_HOGS_MAX; i++) {
+        const esp_microsleep_load_hog_t* hog = &config->hogs[i];
+        if (!hog->busy_us) { continue; }
+        if (hog->priority >= configMAX_PRIORITIES) { return false; }
+        if (hog->core != tskNO_AFFINITY && (hog->core < 0 || hog->core >= portNUM_PROCESSORS)) { return false; }
+        if (hog->period_ms && (uint64_t) hog->period_ms * 1000 <= hog->busy_us) { return false; }
+    }
+    if (config->isr_period_us && (config->isr_period_us < 50 || config->isr_busy_us >= config->isr_period_us)) { return false; }
+    if (config->contention_hold_us && config->contention_priority >= configMAX_PRIORITIES) { return false; }
+    if (config->cache_pressure && config->cache_priority >= configMAX_PRIORITIES) { return false; }
+    return true;
+}
+
+esp_err_t esp_microsleep_load_start(const esp_microsleep_load_config_t* config) {
+
+    if (!config || !esp_microsleep_load_valid(config)) { return ESP_ERR_INVALID_ARG; }
+    if (esp_microsleep_load_active()) { return ESP_ERR_INVALID_STATE; }
+
+    if (!esp_microsleep_load_done) {
+        const UBaseType_t max_tasks = CONFIG_ESP_MICROSLEEP_LOAD_HOGS_MAX + portNUM_PROCESSORS + 1;
+        esp_microsleep_load_done = xSemaphoreCreateCounting(max_tasks, 0);
+        if (!esp_microsleep_load_done) { return ESP_ERR_NO_MEM; }
+    }
+    esp_microsleep_load_config = *config;
+    esp_microsleep_load_tasks = 0;
+    __atomic_store_n(&esp_microsleep_load_running, true, __ATOMIC_RELAXED);
+
+    bool spawned = true;
+    esp_err_t err = ESP_OK;
+    for (int i = 0; spawned && i < CONFIG_ESP_MICROSLEEP_LOAD_HOGS_MAX; i++) {
+        esp_microsleep_load_hog_t* hog = &esp_microsleep_load_config.hogs[i];
+        if (!hog->busy_us) { continue; }
+        spawned = esp_microsleep_load_spawn(esp_microsleep_load_hog_task, "microsleep_hog", hog, hog->priority, hog->core);
+    }
+    if (esp_microsleep_load_config.contention_hold_us) {
+        for (BaseType_t core = 0; spawned && core < portNUM_PROCESSORS; core++) {
+            spawned = esp_microsleep_load_spawn(esp_microsleep_load_contention_task, "microsleep_lock", NULL, esp_microsleep_load_config.contention_priority, core);
+        }
+    }
+    if (spawned && esp_microsleep_load_config.cache_pressure) {
+        spawned = esp_microsleep_load_spawn(esp_microsleep_load_cache_task, "microsleep_cache", NULL, esp_microsleep_load_config.cache_priority, tskNO_AFFINITY);
+    }
+    if (spawned && esp_microsleep_load_config.isr_period_us) {
+        const esp_timer_create_args_t storm_timer_args = {
+            .callback = esp_microsleep_load_isr,
+            .dispatch_method = ESP_TIMER_ISR,
+            .name = "microsleep_storm",
+        };
+        err = esp_timer_create(&storm_timer_args, &esp_microsleep_load_timer);
+        if (err == ESP_OK) { err = esp_timer_start_periodic(esp_microsleep_load_timer, esp_microsleep_load_config.isr_period_us); }
+    }
+    if (!spawned) { err = ESP_ERR_NO_MEM; }
+    if (err != ESP_OK) {
+        // Tears down whatever has been started, including a storm timer that failed to start.
+        esp_microsleep_load_stop();
+    }
+    return err;
+}
+
+esp_err_t esp_microsleep_load_stop() {
+
+    if (!esp_microsleep_load_active()) { return ESP_ERR_INVALID_STATE; }
+
+    if (esp_microsleep_load_timer) {
+        esp_timer_stop(esp_microsleep_load_timer);
+        ESP_ERROR_CHECK(esp_timer_delete(esp_microsleep_load_timer));
+        esp_microsleep_load_timer = NULL;
+    }
+    __atomic_store_n(&esp_microsleep_load_running, false, __ATOMIC_RELAXED);
+    for (UBaseType_t i = 0; i < esp_microsleep_load_tasks; i++) {
+        xSemaphoreTake(esp_microsleep_load_done, portMAX_DELAY);
+    }
+    esp_microsleep_load_tasks = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_microsleep_calibrate_under_load(const esp_microsleep_load_config_t* config, uint64_t* compensation) {
+
+    const esp_err_t err = esp_microsleep_load_start(config);
+    if (err != ESP_OK) { return err; }
+
+    // Let every load task get scheduled before measuring.
+    vTaskDelay(2);
+    const uint64_t result = esp_microsleep_calibrate();
+    esp_microsleep_load_stop();
+    if (compensation) { *compensation = result; }
+    return ESP_OK;
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_LOAD
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_LOAD_H
+#define ESP_MICROSLEEP_LOAD_H
+
+#include "esp_microsleep.h"
+#include "esp_err.h" // for esp_err_t
+#include "freertos/FreeRTOS.h" // for UBaseType_t, BaseType_t
+#include "stdbool.h" // for bool
+#include "stdint.h" // for uint32_t, uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_LOAD)
+
+/**
+ * @brief A task burning CPU time with a fixed duty cycle.
+ */
+typedef struct {
+    UBaseType_t priority;  ///< FreeRTOS priority of the task.
+    BaseType_t core;       ///< Core to pin the task to, or `tskNO_AFFINITY`.
+    uint32_t busy_us;      ///< CPU time burnt per period, 0 to disable the hog.
+    uint32_t period_ms;    ///< Period, rounded to ticks. 0 burns continuously, yielding only to tasks of the same priority.
+} esp_microsleep_load_hog_t;
+
+/**
+ * @brief Synthetic load, see `esp_microsleep_load_start`.
+ *
+ * Zero-initialized members disable the respective kind of load.
+ */
+typedef struct {
+    esp_microsleep_load_hog_t hogs[CONFIG_ESP_MICROSLEEP_LOAD_HOGS_MAX]; ///< CPU hog tasks.
+    uint32_t isr_period_us;          ///< Period of the interrupt storm, at least 50 µs, 0 to disable.
+    uint32_t isr_busy_us;            ///< Time spent in each interrupt, less than `isr_period_us`.
+    uint32_t contention_hold_us;     ///< Time a task on each core holds a shared spinlock (with interrupts masked), 0 to disable.
+    UBaseType_t contention_priority; ///< FreeRTOS priority of the contention tasks.
+    bool cache_pressure;             ///< Stream through a flash-resident table to evict the flash cache.
+    UBaseType_t cache_priority;      ///< FreeRTOS priority of the cache pressure task.
+} esp_microsleep_load_config_t;
+
+/**
+ * @brief A moderately busy system: half of each core burnt at priority 1,
+ *        a 5 µs interrupt every 500 µs, spinlock contention across the cores and flash cache misses.
+ */
+#define ESP_MICROSLEEP_LOAD_TYPICAL { \
+    .hogs = { \
+        { .priority = 1, .core = 0, .busy_us = 1000, .period_ms = 2 }, \
+        { .priority = 1, .core = portNUM_PROCESSORS - 1, .busy_us = 1000, .period_ms = 2 }, \
+    }, \
+    .isr_period_us = 500, \
+    .isr_busy_us = 5, \
+    .contention_hold_us = 2, \
+    .contention_priority = 1, \
+    .cache_pressure = true, \
+    .cache_priority = 1, \
+}
+
+/**
+ * @brief Start generating synthetic load, to calibrate and benchmark under reproducible conditions.
+ *
+ * The load runs until `esp_microsleep_load_stop`. Hogs running continuously at or above the
+ * priority of the calling task on its core will keep it from ever stopping the load.
+ *
+ * @param[in] config The load.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid configuration,
+ *         ESP_ERR_INVALID_STATE if the load is already running, ESP_ERR_NO_MEM if out of memory,
+ *         or the error of creating or starting the interrupt storm timer.
+ */
+esp_err_t esp_microsleep_load_start(const esp_microsleep_load_config_t* config);
+
+/**
+ * @brief Stop the synthetic load and wait for its tasks to exit.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the load is not running.
+ */
+esp_err_t esp_microsleep_load_stop();
+
+/**
+ * @brief Run `esp_microsleep_calibrate` under synthetic load.
+ *
+ * Use this instead of calibrating under whatever load happens to be present,
+ * so the compensation is comparable across runs and releases.
+ *
+ * @param[in] config The load.
+ * @param[out] compensation The computed compensation in microseconds, or NULL.
+ *
+ * @return ESP_OK on success, otherwise the error of `esp_microsleep_load_start`.
+ */
+esp_err_t esp_microsleep_calibrate_under_load(const esp_microsleep_load_config_t* config, uint64_t* compensation);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_LOAD
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_LOAD_H
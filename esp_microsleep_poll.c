@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_poll.h"
+
+#include "esp_timer.h"
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+esp_err_t esp_microsleep_poll_until(esp_microsleep_poller_t* poller, esp_microsleep_poll_cond_t cond, void* arg, uint64_t timeout_us) {
+
+    if (!poller || !cond) { return ESP_ERR_INVALID_ARG; }
+
+    const uint64_t start = esp_timer_get_time();
+    const uint64_t deadline = start + timeout_us;
+    poller->polls = 0;
+
+    // Sleep through most of the usual completion time, a bit early rather than late.
+    uint64_t wait = poller->expected16 / 16;
+    wait -= wait / 8;
+    uint64_t step = CONFIG_ESP_MICROSLEEP_POLL_STEP_MIN_US;
+    for (;;) {
+        if (wait) {
+            const uint64_t now = esp_timer_get_time();
+            if (now >= deadline) { return cond(arg) ? ESP_OK : ESP_ERR_TIMEOUT; }
+            if (wait > deadline - now) { wait = deadline - now; }
+            if (esp_microsleep_delay(wait) != ESP_OK) {
+                // The deadline scope of the task has expired.
+                return cond(arg) ? ESP_OK : ESP_ERR_TIMEOUT;
+            }
+        }
+        poller->polls++;
+        if (cond(arg)) { break; }
+        wait = step;
+        step = step * 2 < CONFIG_ESP_MICROSLEEP_POLL_STEP_MAX_US ? step * 2 : CONFIG_ESP_MICROSLEEP_POLL_STEP_MAX_US;
+    }
+
+    const uint32_t elapsed = esp_timer_get_time() - start;
+    if (poller->expected16) {
+        poller->expected16 += ((int32_t)(elapsed * 16) - (int32_t) poller->expected16) / 8;
+    } else {
+        poller->expected16 = elapsed * 16;
+    }
+    return ESP_OK;
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
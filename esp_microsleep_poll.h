@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_POLL_H
+#define ESP_MICROSLEEP_POLL_H
+
+#include "esp_microsleep.h"
+#include "esp_err.h" // for esp_err_t
+#include "stdbool.h" // for bool
+#include "stdint.h" // for uint32_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+/**
+ * @brief Condition polled by `esp_microsleep_poll_until`, e.g. reading a device status register.
+ */
+typedef bool (*esp_microsleep_poll_cond_t)(void* arg);
+
+/**
+ * @brief State of a poller, learning how long the polled operation usually takes.
+ *
+ * Use one poller per kind of operation, e.g. one for EEPROM page writes and one for ADC
+ * conversions, and initialize it with `ESP_MICROSLEEP_POLLER_INIT`.
+ */
+typedef struct {
+    uint32_t expected16;   ///< Moving average of the completion time, in 1/16 µs.
+    uint32_t polls;        ///< Condition checks of the last call.
+} esp_microsleep_poller_t;
+
+#define ESP_MICROSLEEP_POLLER_INIT { .expected16 = 0, .polls = 0 }
+
+/**
+ * @brief Wait until a condition becomes true.
+ *
+ * Sleeps for most of the completion time learned by `poller` before checking the condition
+ * the first time. Then the condition is checked in intervals growing exponentially from
+ * CONFIG_ESP_MICROSLEEP_POLL_STEP_MIN_US to CONFIG_ESP_MICROSLEEP_POLL_STEP_MAX_US, so that
+ * short intervals are spun and long ones are slept, see `esp_microsleep_delay`.
+ *
+ * @param[inout] poller The poller.
+ * @param[in] cond Condition to wait for.
+ * @param[in] arg Argument passed to `cond`.
+ * @param[in] timeout_us Timeout in microseconds.
+ *
+ * @return ESP_OK when the condition became true, ESP_ERR_TIMEOUT if it didn't within the
+ *         timeout or the deadline scope of the task, ESP_ERR_INVALID_ARG for invalid arguments.
+ */
+esp_err_t esp_microsleep_poll_until(esp_microsleep_poller_t* poller, esp_microsleep_poll_cond_t cond, void* arg, uint64_t timeout_us);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_POLL_H
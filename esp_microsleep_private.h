@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_PRIVATE_H
+#define ESP_MICROSLEEP_PRIVATE_H
+
+// Interfaces between the translation units of this component. Not part of the public API.
+
+#include "esp_microsleep.h"
+#ifdef CONFIG_ESP_MICROSLEEP_PROFILE
+#include "esp_microsleep_profile.h"
+#include "esp_cpu.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+/**
+ * Like esp_microsleep_delay, but ignores the deadline scope of the task. For callers that
+ * don't know about scopes and would turn into busy loops, if their sleeps returned early.
+ */
+esp_err_t esp_microsleep_delay_unscoped(uint64_t us);
+
+#ifdef CONFIG_ESP_MICROSLEEP_ALERTS
+/**
+ * Consecutive late wakeups of a task for one alert slot, void once the slot is reused.
+ */
+typedef struct {
+    uint16_t generation;  // of the slot when the streak started
+    uint16_t count;
+} esp_microsleep_alert_streak_t;
+
+/**
+ * Feeds the overshoot of a finished delay into the registered alerts.
+ * `streaks` points to the task's CONFIG_ESP_MICROSLEEP_ALERTS_MAX streaks.
+ */
+void esp_microsleep_alert_feed(TaskHandle_t task, esp_microsleep_alert_streak_t* streaks, uint32_t overshoot_us);
+#endif
+
+#ifdef CONFIG_ESP_MICROSLEEP_TRACE
+/**
+ * Records a finished delay in the trace stream, if a trace is running.
+ * `id` and `generation` identify the task in the stream and are maintained by the tracer.
+ */
+void esp_microsleep_trace_record(uint16_t* id, uint16_t* generation, const char* name, uint8_t strategy, uint64_t end_us, uint64_t requested_us, uint64_t armed_us, uint64_t elapsed_us);
+#endif
+
+#ifdef CONFIG_ESP_MICROSLEEP_BENCH
+/**
+ * Accounts the CPU cycles spent in one run of a wakeup timer callback.
+ */
+void esp_microsleep_bench_isr(uint32_t cycles);
+#endif
+
+#ifdef CONFIG_ESP_MICROSLEEP_PROFILE
+/**
+ * Accounts the CPU cycles spent in one run of a hot path phase.
+ */
+void esp_microsleep_profile_add(esp_microsleep_profile_phase_t phase, uint32_t cycles);
+
+// Start a phase measurement in `var`, and account it with ESP_MICROSLEEP_PROFILE_ADD. No-ops without CONFIG_ESP_MICROSLEEP_PROFILE.
+#define ESP_MICROSLEEP_PROFILE_MARK(var) const uint32_t var = esp_cpu_get_cycle_count()
+#define ESP_MICROSLEEP_PROFILE_ADD(phase, var) esp_microsleep_profile_add(phase, esp_cpu_get_cycle_count() - (var))
+#else
+#define ESP_MICROSLEEP_PROFILE_MARK(var)
+#define ESP_MICROSLEEP_PROFILE_ADD(phase, var)
+#endif
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_PRIVATE_H
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_profile.h"
+#include "esp_microsleep_private.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_PROFILE)
+
+static const char* const esp_microsleep_profile_names[] = {
+    [ESP_MICROSLEEP_PROFILE_LOOKUP] = "lookup",
+    [ESP_MICROSLEEP_PROFILE_PREPARE] = "prepare",
+    [ESP_MICROSLEEP_PROFILE_ARM] = "arm",
+    [ESP_MICROSLEEP_PROFILE_WAKE] = "wake",
+};
+
+static portMUX_TYPE esp_microsleep_profile_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_microsleep_profile_t esp_microsleep_profile[ESP_MICROSLEEP_PROFILE_PHASES];
+
+void esp_microsleep_profile_add(esp_microsleep_profile_phase_t phase, uint32_t cycles) {
+
+    esp_microsleep_profile_t* entry = &esp_microsleep_profile[phase];
+    portENTER_CRITICAL(&esp_microsleep_profile_lock);
+    if (!entry->count || cycles < entry->min_cycles) { entry->min_cycles = cycles; }
+    if (cycles > entry->max_cycles) { entry->max_cycles = cycles; }
+    entry->cycles += cycles;
+    entry->count++;
+    portEXIT_CRITICAL(&esp_microsleep_profile_lock);
+}
+
+void esp_microsleep_profile_get(esp_microsleep_profile_t profile[ESP_MICROSLEEP_PROFILE_PHASES]) {
+
+    portENTER_CRITICAL(&esp_microsleep_profile_lock);
+    memcpy(profile, esp_microsleep_profile, sizeof(esp_microsleep_profile));
+    portEXIT_CRITICAL(&esp_microsleep_profile_lock);
+}
+
+void esp_microsleep_profile_reset() {
+
+    portENTER_CRITICAL(&esp_microsleep_profile_lock);
+    memset(esp_microsleep_profile, 0, sizeof(esp_microsleep_profile));
+    portEXIT_CRITICAL(&esp_microsleep_profile_lock);
+}
+
+void esp_microsleep_profile_print(FILE* out) {
+
+    esp_microsleep_profile_t profile[ESP_MICROSLEEP_PROFILE_PHASES];
+    esp_microsleep_profile_get(profile);
+    fprintf(out, "phase,count,min_cycles,avg_cycles,max_cycles\n");
+    for (int i = 0; i < ESP_MICROSLEEP_PROFILE_PHASES; i++) {
+        fprintf(out, "%s,%" PRIu32 ",%" PRIu32 ",%" PRIu64 ",%" PRIu32 "\n", esp_microsleep_profile_names[i], profile[i].count,
+                profile[i].min_cycles, profile[i].count ? profile[i].cycles / profile[i].count : 0, profile[i].max_cycles);
+    }
+}
+
+typedef enum {
+    ESP_MICROSLEEP_PRIMITIVE_EMPTY,
+    ESP_MICROSLEEP_PRIMITIVE_TLS,
+    ESP_MICROSLEEP_PRIMITIVE_MUL64,
+    ESP_MICROSLEEP_PRIMITIVE_DIV64,
+    ESP_MICROSLEEP_PRIMITIVE_GET_TIME,
+    ESP_MICROSLEEP_PRIMITIVE_TIMER_START,
+    ESP_MICROSLEEP_PRIMITIVE_TIMER_STOP,
+    ESP_MICROSLEEP_PRIMITIVE_NOTIFY_WAIT,
+    ESP_MICROSLEEP_PRIMITIVES,
+} esp_microsleep_primitive_t;
+
+static const char* const esp_microsleep_primitive_names[] = {
+    [ESP_MICROSLEEP_PRIMITIVE_TLS] = "tls_lookup",
+    [ESP_MICROSLEEP_PRIMITIVE_MUL64] = "mul64",
+    [ESP_MICROSLEEP_PRIMITIVE_DIV64] = "div64",
+    [ESP_MICROSLEEP_PRIMITIVE_GET_TIME] = "esp_timer_get_time",
+    [ESP_MICROSLEEP_PRIMITIVE_TIMER_START] = "esp_timer_start_once",
+    [ESP_MICROSLEEP_PRIMITIVE_TIMER_STOP] = "esp_timer_stop",
+    [ESP_MICROSLEEP_PRIMITIVE_NOTIFY_WAIT] = "notify_wait",
+};
+
+static void esp_microsleep_profile_nop(void* arg) {
+}
+
+// Measures one run of `primitive`. Setup and teardown are outside of the measurement.
+static uint32_t esp_microsleep_profile_measure(esp_microsleep_primitive_t primitive, esp_timer_handle_t timer) {
+
+    static volatile uint64_t a = 0x123456789abcdefULL, b = 1000003;
+    volatile uint64_t result;
+    uint32_t start, end;
+
+    switch (primitive) {
+        case ESP_MICROSLEEP_PRIMITIVE_EMPTY:
+            start = esp_cpu_get_cycle_count();
+            end = esp_cpu_get_cycle_count();
+            break;
+        case ESP_MICROSLEEP_PRIMITIVE_TLS:
+            start = esp_cpu_get_cycle_count();
+            result = (uintptr_t) pvTaskGetThreadLocalStoragePointer(NULL, CONFIG_ESP_MICROSLEEP_TLS_INDEX);
+            end = esp_cpu_get_cycle_count();
+            break;
+        case ESP_MICROSLEEP_PRIMITIVE_MUL64:
+            start = esp_cpu_get_cycle_count();
+            result = a * b + a;
+            end = esp_cpu_get_cycle_count();
+            break;
+        case ESP_MICROSLEEP_PRIMITIVE_DIV64:
+            start = esp_cpu_get_cycle_count();
+            result = a / b;
+            end = esp_cpu_get_cycle_count();
+            break;
+        case ESP_MICROSLEEP_PRIMITIVE_GET_TIME:
+            start = esp_cpu_get_cycle_count();
+            result = esp_timer_get_time();
+            end = esp_cpu_get_cycle_count();
+            break;
+        case ESP_MICROSLEEP_PRIMITIVE_TIMER_START:
+            start = esp_cpu_get_cycle_count();
+            esp_timer_start_once(timer, 1000000);
+            end = esp_cpu_get_cycle_count();
+            esp_timer_stop(timer);
+            break;
+        case ESP_MICROSLEEP_PRIMITIVE_TIMER_STOP:
+            esp_timer_start_once(timer, 1000000);
+            start = esp_cpu_get_cycle_count();
+            esp_timer_stop(timer);
+            end = esp_cpu_get_cycle_count();
+            break;
+        case ESP_MICROSLEEP_PRIMITIVE_NOTIFY_WAIT:
+            // Already notified, so it returns without blocking, like after a timely wakeup.
+            xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+            start = esp_cpu_get_cycle_count();
+            xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
+            end = esp_cpu_get_cycle_count();
+            break;
+        default:
+            return 0;
+    }
+    (void) result;
+    return end - start;
+}
+
+esp_err_t esp_microsleep_profile_primitives(uint32_t iterations, FILE* out) {
+
+    if (!iterations || !out) { return ESP_ERR_INVALID_ARG; }
+
+    esp_timer_handle_t timer;
+    const esp_timer_create_args_t timer_args = {
+        .callback = esp_microsleep_profile_nop,
+        .dispatch_method = ESP_TIMER_ISR,
+        .name = "microsleep_profile",
+    };
+    const esp_err_t err = esp_timer_create(&timer_args, &timer);
+    if (err != ESP_OK) { return err; }
+
+    uint32_t overhead = 0;
+    fprintf(out, "primitive,iterations,min_cycles,avg_cycles\n");
+    for (int primitive = ESP_MICROSLEEP_PRIMITIVE_EMPTY; primitive < ESP_MICROSLEEP_PRIMITIVES; primitive++) {
+        uint32_t min = UINT32_MAX;
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            const uint32_t cycles = esp_microsleep_profile_measure(primitive, timer);
+            if (cycles < min) { min = cycles; }
+            sum += cycles;
+        }
+        if (primitive == ESP_MICROSLEEP_PRIMITIVE_EMPTY) {
+            // The cost of reading the cycle counter, subtracted from the other primitives.
+            overhead = min;
+            continue;
+        }
+        const uint64_t avg = sum / iterations;
+        fprintf(out, "%s,%" PRIu32 ",%" PRIu32 ",%" PRIu64 "\n", esp_microsleep_primitive_names[primitive], iterations,
+                min > overhead ? min - overhead : 0, avg > overhead ? avg - overhead : 0);
+    }
+    return esp_timer_delete(timer);
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_PROFILE
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_PROFILE_H
+#define ESP_MICROSLEEP_PROFILE_H
+
+#include "esp_microsleep.h"
+#include "esp_err.h" // for esp_err_t
+#include "stdint.h" // for uint32_t, uint64_t
+#include "stdio.h" // for FILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_PROFILE)
+
+/**
+ * @brief Phases of `esp_microsleep_delay` measured in CPU cycles.
+ */
+typedef enum {
+    ESP_MICROSLEEP_PROFILE_LOOKUP,   ///< Looking up the task context in the thread local storage.
+    ESP_MICROSLEEP_PROFILE_PREPARE,  ///< Deadline, compensation and strategy computations before waiting.
+    ESP_MICROSLEEP_PROFILE_ARM,      ///< Arming the wakeup timer.
+    ESP_MICROSLEEP_PROFILE_WAKE,     ///< Bookkeeping after the wakeup notification arrived.
+    ESP_MICROSLEEP_PROFILE_PHASES,
+} esp_microsleep_profile_phase_t;
+
+/**
+ * @brief Cycle counts of one phase.
+ */
+typedef struct {
+    uint32_t count;       ///< Number of measurements.
+    uint64_t cycles;      ///< Sum of all measurements.
+    uint32_t min_cycles;  ///< Cheapest measurement.
+    uint32_t max_cycles;  ///< Most expensive measurement, e.g. the first call of a task allocating its context.
+} esp_microsleep_profile_t;
+
+/**
+ * @brief Get the cycle counts of the hot path phases, accumulated by all tasks since the last reset.
+ *
+ * @param[out] profile One entry per phase.
+ *
+ * @return None.
+ */
+void esp_microsleep_profile_get(esp_microsleep_profile_t profile[ESP_MICROSLEEP_PROFILE_PHASES]);
+
+/**
+ * @brief Reset the cycle counts of the hot path phases.
+ *
+ * @return None.
+ */
+void esp_microsleep_profile_reset();
+
+/**
+ * @brief Write the cycle counts of the hot path phases as CSV.
+ *
+ * @param[in] out Where to write the CSV.
+ *
+ * @return None.
+ */
+void esp_microsleep_profile_print(FILE* out);
+
+/**
+ * @brief Measure the primitives of the hot path in isolation.
+ *
+ * Runs each primitive (thread local storage lookup, 64-bit arithmetic, `esp_timer_get_time`,
+ * `esp_timer_start_once`, `esp_timer_stop`, a task notification wait that doesn't block)
+ * `iterations` times in the calling task and writes CSV with the minimum and average cycles,
+ * minus the cost of reading the cycle counter.
+ *
+ * @param[in] iterations Measurements per primitive.
+ * @param[in] out Where to write the CSV.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for invalid arguments, or the error of
+ *         creating or deleting the timer used to profile the esp_timer primitives.
+ */
+esp_err_t esp_microsleep_profile_primitives(uint32_t iterations, FILE* out);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_PROFILE
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_PROFILE_H
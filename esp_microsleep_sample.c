@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_sample.h"
+
+#include "esp_timer.h"
+
+#include <string.h>
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+esp_err_t esp_microsleep_sample_loop(esp_microsleep_sample_fn_t fn, void* arg, uint32_t period_us, size_t n, esp_microsleep_sample_t* out, size_t* late) {
+
+    if (!fn || (n && !out)) { return ESP_ERR_INVALID_ARG; }
+
+    size_t late_samples = 0;
+    esp_err_t result = ESP_OK;
+    const uint64_t start = esp_timer_get_time();
+    for (size_t i = 0; i < n; i++) {
+        const uint64_t due = start + (uint64_t) i * period_us;
+        if (esp_microsleep_delay_until(due) != ESP_OK) {
+            memset(&out[i], 0, (n - i) * sizeof(out[0]));
+            result = ESP_ERR_TIMEOUT;
+            break;
+        }
+        const uint64_t now = esp_timer_get_time();
+        out[i].timestamp_us = now;
+        out[i].value = fn(arg);
+        if (now > due + CONFIG_ESP_MICROSLEEP_SAMPLE_LATE_US) { late_samples++; }
+    }
+    if (late) { *late = late_samples; }
+    return result;
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
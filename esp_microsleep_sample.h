@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_SAMPLE_H
+#define ESP_MICROSLEEP_SAMPLE_H
+
+#include "esp_microsleep.h"
+#include "esp_err.h" // for esp_err_t
+#include "stddef.h" // for size_t
+#include "stdint.h" // for int32_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+/**
+ * @brief Takes a single sample, e.g. reads an ADC channel.
+ */
+typedef int32_t (*esp_microsleep_sample_fn_t)(void* arg);
+
+/**
+ * @brief A sample with the time it has actually been taken.
+ */
+typedef struct {
+    uint64_t timestamp_us;   ///< `esp_timer_get_time()` right before the sample function was called.
+    int32_t value;           ///< Value returned by the sample function.
+} esp_microsleep_sample_t;
+
+/**
+ * @brief Call a sample function periodically and collect the results.
+ *
+ * Sample `i` is due at `start + i * period_us`. All due times are derived from a single time
+ * base, so the duration of the sample function does not accumulate into a drift. A sample
+ * taken more than CONFIG_ESP_MICROSLEEP_SAMPLE_LATE_US after its due time counts as late;
+ * its timestamp tells the true sample time.
+ *
+ * @param[in] fn Sample function.
+ * @param[in] arg Argument passed to `fn`.
+ * @param[in] period_us Sampling period in microseconds.
+ * @param[in] n Number of samples.
+ * @param[out] out Array of `n` entries receiving the samples. Entries not taken due to
+ *                 an expired deadline scope have a timestamp of 0.
+ * @param[out] late Receives the number of late samples. May be NULL.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for invalid arguments, ESP_ERR_TIMEOUT
+ *         if the deadline scope of the task expired before all samples were taken.
+ */
+esp_err_t esp_microsleep_sample_loop(esp_microsleep_sample_fn_t fn, void* arg, uint32_t period_us, size_t n, esp_microsleep_sample_t* out, size_t* late);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_SAMPLE_H
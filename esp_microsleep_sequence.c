@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_sequence.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+static inline void IRAM_ATTR esp_microsleep_spin_until_cycles(uint32_t target) {
+    while ((int32_t)(esp_cpu_get_cycle_count() - target) < 0) { }
+}
+
+// Translates `deadline_us` to the cycle counter of the current core. The counter is per core
+// and its rate follows the CPU frequency, so this is done right before each spin.
+static inline uint32_t IRAM_ATTR esp_microsleep_sequence_cycles(uint64_t deadline_us, uint32_t* cycles_per_us) {
+    *cycles_per_us = esp_rom_get_cpu_ticks_per_us();
+    const int64_t now_us = esp_timer_get_time();
+    const uint32_t now_cycles = esp_cpu_get_cycle_count();
+    return now_cycles + (uint32_t)(((int64_t) deadline_us - now_us) * (int64_t) *cycles_per_us);
+}
+
+esp_err_t esp_microsleep_sequence_play(const esp_microsleep_step_t* steps, size_t count, int32_t* errors_ns) {
+
+    if (!steps && count) { return ESP_ERR_INVALID_ARG; }
+    for (size_t i = 0; i < count; i++) {
+        if ((unsigned) steps[i].mode > ESP_MICROSLEEP_SEGMENT_SPIN_CRITICAL) { return ESP_ERR_INVALID_ARG; }
+        if (i && steps[i].offset_us < steps[i - 1].offset_us) { return ESP_ERR_INVALID_ARG; }
+    }
+
+    if (count && (uint64_t)steps[count - 1].offset_us * esp_rom_get_cpu_ticks_per_us() > INT32_MAX) { return ESP_ERR_INVALID_SIZE; }
+
+    const uint64_t start_us = esp_timer_get_time();
+
+    for (size_t i = 0; i < count; i++) {
+        const esp_microsleep_step_t* step = &steps[i];
+        const uint64_t deadline_us = start_us + step->offset_us;
+        uint32_t cycles_per_us;
+        uint32_t deadline_cycles;
+        UBaseType_t state = 0;
+        bool masked = false;
+
+        switch (step->mode) {
+            case ESP_MICROSLEEP_SEGMENT_AUTO:
+                esp_microsleep_delay_until(deadline_us - CONFIG_ESP_MICROSLEEP_SEQUENCE_SPIN_US);
+                deadline_cycles = esp_microsleep_sequence_cycles(deadline_us, &cycles_per_us);
+                esp_microsleep_spin_until_cycles(deadline_cycles);
+                break;
+            case ESP_MICROSLEEP_SEGMENT_SLEEP:
+                esp_microsleep_delay_until(deadline_us);
+                deadline_cycles = esp_microsleep_sequence_cycles(deadline_us, &cycles_per_us);
+                break;
+            case ESP_MICROSLEEP_SEGMENT_SPIN:
+                deadline_cycles = esp_microsleep_sequence_cycles(deadline_us, &cycles_per_us);
+                esp_microsleep_spin_until_cycles(deadline_cycles);
+                break;
+            case ESP_MICROSLEEP_SEGMENT_SPIN_CRITICAL:
+                // Only the final window is spun with interrupts masked.
+                esp_microsleep_spin_until_cycles(esp_microsleep_sequence_cycles(deadline_us - CONFIG_ESP_MICROSLEEP_SEQUENCE_CRITICAL_US, &cycles_per_us));
+                state = portSET_INTERRUPT_MASK_FROM_ISR();
+                masked = true;
+                deadline_cycles = esp_microsleep_sequence_cycles(deadline_us, &cycles_per_us);
+                esp_microsleep_spin_until_cycles(deadline_cycles);
+                break;
+        }
+
+        const uint32_t released_cycles = esp_cpu_get_cycle_count();
+        if (step->action) { step->action(step->arg); }
+        if (masked) { portCLEAR_INTERRUPT_MASK_FROM_ISR(state); }
+        if (errors_ns) {
+            errors_ns[i] = (int32_t)((int64_t)(int32_t)(released_cycles - deadline_cycles) * 1000 / cycles_per_us);
+        }
+    }
+    return ESP_OK;
+}
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
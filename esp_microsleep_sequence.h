@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_SEQUENCE_H
+#define ESP_MICROSLEEP_SEQUENCE_H
+
+#include "esp_microsleep.h"
+#include "esp_err.h" // for esp_err_t
+#include "stddef.h" // for size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+
+/**
+ * @brief How the time leading up to a sequence step is spent.
+ */
+typedef enum {
+    ESP_MICROSLEEP_SEGMENT_AUTO = 0,       ///< Timer sleep while worthwhile, cycle-counter spin for the last part.
+    ESP_MICROSLEEP_SEGMENT_SLEEP,          ///< Timer sleep only (cheapest, least accurate).
+    ESP_MICROSLEEP_SEGMENT_SPIN,           ///< Cycle-counter spin only.
+    ESP_MICROSLEEP_SEGMENT_SPIN_CRITICAL,  ///< Cycle-counter spin, the last `CONFIG_ESP_MICROSLEEP_SEQUENCE_CRITICAL_US` and the action with interrupts masked.
+} esp_microsleep_segment_mode_t;
+
+/**
+ * @brief A single step of a timed sequence.
+ */
+typedef struct {
+    uint32_t offset_us;                    ///< Release time, relative to the start of the sequence.
+    esp_microsleep_segment_mode_t mode;    ///< How to wait for the release time.
+    void (*action)(void* arg);             ///< Called at the release time, e.g. a GPIO write. May be NULL.
+    void* arg;                             ///< Argument passed to `action`.
+} esp_microsleep_step_t;
+
+/**
+ * @brief Play back a timed sequence of actions.
+ *
+ * All release times are computed from a single time base taken when the sequence starts,
+ * so the overhead of one step does not shift the following ones. The spin parts are timed
+ * using the CPU cycle counter, which is why the whole sequence must fit into 2^31 CPU cycles
+ * (about 8.9 s at 240 MHz).
+ *
+ * The cycle counter is per core and runs at the CPU frequency, so each spin translates its
+ * release time from `esp_timer_get_time()` right before it starts. A task preempted and moved
+ * to the other core, or a frequency change, in the middle of a spin still spoils that step;
+ * for the best accuracy, pin the task to a core and hold an `ESP_PM_CPU_FREQ_MAX` lock while playing.
+ *
+ * Actions of `ESP_MICROSLEEP_SEGMENT_SPIN_CRITICAL` steps run with interrupts masked on the current core;
+ * keep them short and do not call blocking functions from them.
+ *
+ * @param[in] steps Steps, ordered by non-decreasing `offset_us`.
+ * @param[in] count Number of steps.
+ * @param[out] errors_ns Optional array of `count` entries receiving the achieved release
+ *                       error per step in nanoseconds (positive means late). May be NULL.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for unordered steps or an unknown mode,
+ *         ESP_ERR_INVALID_SIZE if the sequence is too long for the cycle counter.
+ */
+esp_err_t esp_microsleep_sequence_play(const esp_microsleep_step_t* steps, size_t count, int32_t* errors_ns);
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_SEQUENCE_H
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "esp_microsleep_trace.h"
+#include "esp_microsleep_private.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#ifdef CONFIG_ESP_MICROSLEEP_TRACE
+#include "freertos/ringbuf.h"
+#include "driver/uart.h"
+#ifdef CONFIG_APPTRACE_ENABLE
+#include "esp_app_trace.h"
+#endif
+#endif
+
+#include <string.h>
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_TRACE)
+
+#define ESP_MICROSLEEP_TRACE_CHUNK 512
+
+static RingbufHandle_t esp_microsleep_trace_buffer = NULL;  // stream generation, then the encoded record, DELAY records with absolute end times
+static SemaphoreHandle_t esp_microsleep_trace_sink_lock = NULL;  // held while the sink is called
+static esp_microsleep_trace_sink_t esp_microsleep_trace_sink = NULL;
+static void* esp_microsleep_trace_sink_arg = NULL;
+static bool esp_microsleep_trace_running = false;
+static uint16_t esp_microsleep_trace_generation = 0;  // incremented per stream, see esp_microsleep_trace_record
+static uint16_t esp_microsleep_trace_next_id = 0;
+static uint32_t esp_microsleep_trace_dropped = 0;
+
+static void esp_microsleep_trace_task(void* arg) {
+
+    uint8_t chunk[ESP_MICROSLEEP_TRACE_CHUNK];
+    size_t used = 0;
+    uint64_t last_end = 0;
+    uint16_t generation = 0;
+    esp_microsleep_trace_record_t record;
+
+    for (;;) {
+        // Block for the first record of a chunk, then take what's buffered without waiting.
+        size_t size;
+        uint8_t* item = xRingbufferReceive(esp_microsleep_trace_buffer, &size, used ? 0 : portMAX_DELAY);
+        bool received = false;
+        uint16_t item_generation = 0;
+        if (item) {
+            uint64_t base = 0;
+            if (size > sizeof(item_generation)) {
+                memcpy(&item_generation, item, sizeof(item_generation));
+                received = esp_microsleep_trace_decode(item + sizeof(item_generation), size - sizeof(item_generation), &base, &record) > 0;
+            }
+            vRingbufferReturnItem(esp_microsleep_trace_buffer, item);
+        }
+
+        xSemaphoreTake(esp_microsleep_trace_sink_lock, portMAX_DELAY);
+        if (!esp_microsleep_trace_running) {
+            used = 0;
+            xSemaphoreGive(esp_microsleep_trace_sink_lock);
+            continue;
+        }
+        if (generation != esp_microsleep_trace_generation) {
+            generation = esp_microsleep_trace_generation;
+            last_end = 0;
+            used = esp_microsleep_trace_put_header(chunk);
+        }
+        if (received && item_generation != generation) {
+            // Recorded for a stream stopped since: its task is not announced here and its time base differs.
+            xSemaphoreGive(esp_microsleep_trace_sink_lock);
+            continue;
+        }
+        if (received) {
+            const uint32_t dropped = __atomic_exchange_n(&esp_microsleep_trace_dropped, 0, __ATOMIC_RELAXED);
+            if (dropped) {
+                const esp_microsleep_trace_record_t lost = { .type = ESP_MICROSLEEP_TRACE_RECORD_DROPPED, .dropped = dropped };
+                used += esp_microsleep_trace_encode(chunk + used, &last_end, &lost);
+            }
+            used += esp_microsleep_trace_encode(chunk + used, &last_end, &record);
+        }
+        if (used && (!received || used > sizeof(chunk) - 2 * ESP_MICROSLEEP_TRACE_RECORD_MAX)) {
+            esp_microsleep_trace_sink(chunk, used, esp_microsleep_trace_sink_arg);
+            used = 0;
+        }
+        xSemaphoreGive(esp_microsleep_trace_sink_lock);
+    }
+}
+
+// Encodes a record of stream `generation` without reference to the stream, the trace task re-encodes it in stream order.
+static bool esp_microsleep_trace_push(uint16_t generation, const esp_microsleep_trace_record_t* record) {
+
+    uint8_t item[sizeof(generation) + ESP_MICROSLEEP_TRACE_RECORD_MAX];
+    memcpy(item, &generation, sizeof(generation));
+    uint64_t base = 0;
+    const size_t len = sizeof(generation) + esp_microsleep_trace_encode(item + sizeof(generation), &base, record);
+    return xRingbufferSend(esp_microsleep_trace_buffer, item, len, 0) == pdTRUE;
+}
+
+void esp_microsleep_trace_record(uint16_t* id, uint16_t* generation, const char* name, uint8_t strategy, uint64_t end_us, uint64_t requested_us, uint64_t armed_us, uint64_t elapsed_us) {
+
+    if (!__atomic_load_n(&esp_microsleep_trace_running, __ATOMIC_RELAXED)) { return; }
+
+    // Announce the task name once per stream.
+    const uint16_t current = __atomic_load_n(&esp_microsleep_trace_generation, __ATOMIC_RELAXED);
+    if (!*id) { *id = __atomic_add_fetch(&esp_microsleep_trace_next_id, 1, __ATOMIC_RELAXED); }
+    if (*generation != current) {
+        esp_microsleep_trace_record_t task = { .type = ESP_MICROSLEEP_TRACE_RECORD_TASK, .task = *id };
+        strlcpy(task.name, name, sizeof(task.name));
+        if (!esp_microsleep_trace_push(current, &task)) {
+            // The delay cannot be attributed without the announcement, it is lost as well.
+            __atomic_fetch_add(&esp_microsleep_trace_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        *generation = current;
+    }
+
+    const esp_microsleep_trace_record_t delay = {
+        .type = ESP_MICROSLEEP_TRACE_RECORD_DELAY,
+        .strategy = strategy,
+        .end_us = end_us,
+        .task = *id,
+        .requested_us = requested_us,
+        .armed_us = armed_us,
+        .elapsed_us = elapsed_us,
+    };
+    if (!esp_microsleep_trace_push(current, &delay)) {
+        __atomic_fetch_add(&esp_microsleep_trace_dropped, 1, __ATOMIC_RELAXED);
+    }
+}
+
+esp_err_t esp_microsleep_trace_start(esp_microsleep_trace_sink_t sink, void* arg) {
+
+    if (!sink) { return ESP_ERR_INVALID_ARG; }
+
+    if (!esp_microsleep_trace_buffer) {
+        esp_microsleep_trace_sink_lock = xSemaphoreCreateMutex();
+        if (!esp_microsleep_trace_sink_lock) { return ESP_ERR_NO_MEM; }
+        esp_microsleep_trace_buffer = xRingbufferCreate(CONFIG_ESP_MICROSLEEP_TRACE_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+        if (!esp_microsleep_trace_buffer) {
+            vSemaphoreDelete(esp_microsleep_trace_sink_lock);
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(esp_microsleep_trace_task, "microsleep_trace", CONFIG_ESP_MICROSLEEP_TRACE_TASK_STACK_SIZE, NULL, CONFIG_ESP_MICROSLEEP_TRACE_TASK_PRIORITY, NULL) != pdPASS) {
+            vRingbufferDelete(esp_microsleep_trace_buffer);
+            vSemaphoreDelete(esp_microsleep_trace_sink_lock);
+            esp_microsleep_trace_buffer = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(esp_microsleep_trace_sink_lock, portMAX_DELAY);
+    if (esp_microsleep_trace_running) {
+        xSemaphoreGive(esp_microsleep_trace_sink_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Discard what is left of the previous stream.
+    size_t size;
+    void* stale;
+    while ((stale = xRingbufferReceive(esp_microsleep_trace_buffer, &size, 0))) {
+        vRingbufferReturnItem(esp_microsleep_trace_buffer, stale);
+    }
+    esp_microsleep_trace_sink = sink;
+    esp_microsleep_trace_sink_arg = arg;
+    __atomic_store_n(&esp_microsleep_trace_dropped, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&esp_microsleep_trace_generation, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&esp_microsleep_trace_running, true, __ATOMIC_RELAXED);
+    xSemaphoreGive(esp_microsleep_trace_sink_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_microsleep_trace_stop() {
+
+    if (!esp_microsleep_trace_buffer) { return ESP_ERR_INVALID_STATE; }
+
+    xSemaphoreTake(esp_microsleep_trace_sink_lock, portMAX_DELAY);
+    const bool running = esp_microsleep_trace_running;
+    __atomic_store_n(&esp_microsleep_trace_running, false, __ATOMIC_RELAXED);
+    esp_microsleep_trace_sink = NULL;
+    xSemaphoreGive(esp_microsleep_trace_sink_lock);
+    return running ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_microsleep_trace_sink_uart(const uint8_t* data, size_t len, void* arg) {
+
+    return uart_write_bytes((uart_port_t)(intptr_t) arg, data, len) == (int) len ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_microsleep_trace_sink_ringbuf(const uint8_t* data, size_t len, void* arg) {
+
+    return xRingbufferSend((RingbufHandle_t) arg, data, len, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+#ifdef CONFIG_APPTRACE_ENABLE
+esp_err_t esp_microsleep_trace_sink_apptrace(const uint8_t* data, size_t len, void* arg) {
+
+    return esp_apptrace_write(ESP_APPTRACE_DEST_JTAG, data, len, 10000);
+}
+#endif
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_TRACE
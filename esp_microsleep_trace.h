@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_TRACE_H
+#define ESP_MICROSLEEP_TRACE_H
+
+#include "esp_microsleep.h"
+#include "esp_microsleep_trace_format.h"
+#include "esp_err.h" // for esp_err_t
+#include "stddef.h" // for size_t
+#include "stdint.h" // for uint8_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_ESP_MICROSLEEP_TLS_INDEX) && defined(CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD) && defined(CONFIG_ESP_MICROSLEEP_TRACE)
+
+/**
+ * @brief Trace sink, receives chunks of the binary trace stream.
+ *
+ * Called from the trace task. Returning an error drops the chunk.
+ */
+typedef esp_err_t (*esp_microsleep_trace_sink_t)(const uint8_t* data, size_t len, void* arg);
+
+/**
+ * @brief Start streaming a trace of all delays to a sink.
+ *
+ * Every finished delay is recorded with its requested, armed and elapsed time and passed to
+ * a low-priority task (CONFIG_ESP_MICROSLEEP_TRACE_TASK_PRIORITY), which encodes it as
+ * described in esp_microsleep_trace_format.h and hands it to the sink. Records are dropped
+ * (and the loss recorded), if the task falls more than CONFIG_ESP_MICROSLEEP_TRACE_BUFFER_SIZE
+ * bytes of encoded records behind; the delays themselves never block on tracing.
+ *
+ * Each start begins a new stream with a header.
+ *
+ * @param[in] sink Sink, e.g. one of the `esp_microsleep_trace_sink_*` functions.
+ * @param[in] arg Argument passed to `sink`.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if `sink` is NULL, ESP_ERR_INVALID_STATE
+ *         if a trace is running, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t esp_microsleep_trace_start(esp_microsleep_trace_sink_t sink, void* arg);
+
+/**
+ * @brief Stop streaming the trace.
+ *
+ * Records still queued are discarded. When this returns, the sink is not called anymore.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if no trace is running.
+ */
+esp_err_t esp_microsleep_trace_stop();
+
+/**
+ * @brief Sink writing to a UART. `arg` is the UART port number, cast to a pointer;
+ *        the UART driver must have been installed.
+ */
+esp_err_t esp_microsleep_trace_sink_uart(const uint8_t* data, size_t len, void* arg);
+
+/**
+ * @brief Sink writing to a FreeRTOS ring buffer of type RINGBUF_TYPE_BYTEBUF. `arg` is
+ *        the RingbufHandle_t. Chunks not fitting into the ring buffer are dropped.
+ */
+esp_err_t esp_microsleep_trace_sink_ringbuf(const uint8_t* data, size_t len, void* arg);
+
+#ifdef CONFIG_APPTRACE_ENABLE
+/**
+ * @brief Sink writing to the application trace channel (JTAG), see the ESP-IDF app_trace docs.
+ *        `arg` is unused.
+ */
+esp_err_t esp_microsleep_trace_sink_apptrace(const uint8_t* data, size_t len, void* arg);
+#endif
+
+#endif // CONFIG_ESP_MICROSLEEP_TLS_INDEX && CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_ESP_MICROSLEEP_TRACE
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ESP_MICROSLEEP_TRACE_H
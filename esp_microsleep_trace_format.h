@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#ifndef ESP_MICROSLEEP_TRACE_FORMAT_H
+#define ESP_MICROSLEEP_TRACE_FORMAT_H
+
+// Binary trace format written by esp_microsleep_trace.c and read by tools/trace_analyzer.
+// Plain C without ESP-IDF dependencies, so that host tools can include it.
+//
+// A stream starts with the 4 byte magic "MSTR" and a version byte, followed by records.
+// Each record starts with a tag byte carrying the record type in the low nibble, followed by
+// LEB128 varints. Signed values are zigzag encoded.
+//
+//   DELAY:   tag | strategy << 4, Δend (signed, to the previous DELAY record), task,
+//            requested µs, armed µs (timer part, 0 if spun), elapsed µs
+//   TASK:    tag, task, name length, name (not terminated)
+//   DROPPED: tag, number of DELAY records lost since the previous DROPPED record
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ESP_MICROSLEEP_TRACE_MAGIC "MSTR"
+#define ESP_MICROSLEEP_TRACE_VERSION 1
+#define ESP_MICROSLEEP_TRACE_HEADER_LEN 5
+#define ESP_MICROSLEEP_TRACE_NAME_MAX 32
+#define ESP_MICROSLEEP_TRACE_RECORD_MAX (1 + 5 * 10 + ESP_MICROSLEEP_TRACE_NAME_MAX)
+
+typedef enum {
+    ESP_MICROSLEEP_TRACE_RECORD_DELAY = 0,
+    ESP_MICROSLEEP_TRACE_RECORD_TASK = 1,
+    ESP_MICROSLEEP_TRACE_RECORD_DROPPED = 2,
+} esp_microsleep_trace_record_type_t;
+
+/**
+ * @brief A decoded record.
+ */
+typedef struct {
+    esp_microsleep_trace_record_type_t type;
+    uint8_t strategy;            ///< DELAY: esp_microsleep_strategy_t the delay was served with.
+    uint64_t end_us;             ///< DELAY: time the delay returned, in µs since boot.
+    uint32_t task;               ///< DELAY, TASK: task id, unique within the stream.
+    uint64_t requested_us;       ///< DELAY: requested duration.
+    uint64_t armed_us;           ///< DELAY: duration the timer was armed with.
+    uint64_t elapsed_us;         ///< DELAY: actual duration.
+    uint64_t dropped;            ///< DROPPED: number of lost DELAY records.
+    char name[ESP_MICROSLEEP_TRACE_NAME_MAX + 1];  ///< TASK: zero terminated task name.
+} esp_microsleep_trace_record_t;
+
+static inline size_t esp_microsleep_trace_put_varint(uint8_t* out, uint64_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t) value;
+    return len;
+}
+
+// Returns the number of bytes consumed, 0 if the input is truncated or malformed.
+static inline size_t esp_microsleep_trace_get_varint(const uint8_t* in, size_t len, uint64_t* value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < len && i < 10; i++) {
+        result |= (uint64_t)(in[i] & 0x7f) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static inline uint64_t esp_microsleep_trace_zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t esp_microsleep_trace_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static inline size_t esp_microsleep_trace_put_header(uint8_t* out) {
+    memcpy(out, ESP_MICROSLEEP_TRACE_MAGIC, 4);
+    out[4] = ESP_MICROSLEEP_TRACE_VERSION;
+    return ESP_MICROSLEEP_TRACE_HEADER_LEN;
+}
+
+static inline int esp_microsleep_trace_check_header(const uint8_t* in, size_t len) {
+    return len >= ESP_MICROSLEEP_TRACE_HEADER_LEN && !memcmp(in, ESP_MICROSLEEP_TRACE_MAGIC, 4) && in[4] == ESP_MICROSLEEP_TRACE_VERSION;
+}
+
+/**
+ * @brief Encode a record, the inverse of `esp_microsleep_trace_decode`.
+ *
+ * @param[out] out Buffer of at least ESP_MICROSLEEP_TRACE_RECORD_MAX bytes.
+ * @param[inout] last_end_us End time of the previous DELAY record in the stream, 0 at the start.
+ * @param[in] record The record.
+ *
+ * @return Number of bytes written.
+ */
+static inline size_t esp_microsleep_trace_encode(uint8_t* out, uint64_t* last_end_us, const esp_microsleep_trace_record_t* record) {
+    size_t len = 0;
+    switch (record->type) {
+        case ESP_MICROSLEEP_TRACE_RECORD_DELAY:
+            out[len++] = (uint8_t)(ESP_MICROSLEEP_TRACE_RECORD_DELAY | (record->strategy << 4));
+            len += esp_microsleep_trace_put_varint(out + len, esp_microsleep_trace_zigzag((int64_t)(record->end_us - *last_end_us)));
+            len += esp_microsleep_trace_put_varint(out + len, record->task);
+            len += esp_microsleep_trace_put_varint(out + len, record->requested_us);
+            len += esp_microsleep_trace_put_varint(out + len, record->armed_us);
+            len += esp_microsleep_trace_put_varint(out + len, record->elapsed_us);
+            *last_end_us = record->end_us;
+            break;
+        case ESP_MICROSLEEP_TRACE_RECORD_TASK: {
+            size_t name_len = 0;
+            while (name_len < ESP_MICROSLEEP_TRACE_NAME_MAX && record->name[name_len]) { name_len++; }
+            out[len++] = ESP_MICROSLEEP_TRACE_RECORD_TASK;
+            len += esp_microsleep_trace_put_varint(out + len, record->task);
+            out[len++] = (uint8_t) name_len;
+            memcpy(out + len, record->name, name_len);
+            len += name_len;
+            break;
+        }
+        case ESP_MICROSLEEP_TRACE_RECORD_DROPPED:
+            out[len++] = ESP_MICROSLEEP_TRACE_RECORD_DROPPED;
+            len += esp_microsleep_trace_put_varint(out + len, record->dropped);
+            break;
+    }
+    return len;
+}
+
+/**
+ * @brief Decode a record.
+ *
+ * @param[in] in Input, starting at a tag byte.
+ * @param[in] len Number of bytes available.
+ * @param[inout] last_end_us End time of the previous DELAY record in the stream, 0 at the start.
+ * @param[out] record Receives the record.
+ *
+ * @return Number of bytes consumed, 0 if the input is truncated, -1 if it is malformed.
+ */
+static inline ptrdiff_t esp_microsleep_trace_decode(const uint8_t* in, size_t len, uint64_t* last_end_us, esp_microsleep_trace_record_t* record) {
+    if (!len) { return 0; }
+    size_t pos = 1;
+    size_t used;
+    uint64_t fields[5];
+    record->type = (esp_microsleep_trace_record_type_t)(in[0] & 0x0f);
+    switch (record->type) {
+        case ESP_MICROSLEEP_TRACE_RECORD_DELAY:
+            for (int i = 0; i < 5; i++, pos += used) {
+                if (!(used = esp_microsleep_trace_get_varint(in + pos, len - pos, &fields[i]))) { return len - pos >= 10 ? -1 : 0; }
+            }
+            record->strategy = in[0] >> 4;
+            record->end_us = *last_end_us + (uint64_t) esp_microsleep_trace_unzigzag(fields[0]);
+            record->task = (uint32_t) fields[1];
+            record->requested_us = fields[2];
+            record->armed_us = fields[3];
+            record->elapsed_us = fields[4];
+            *last_end_us = record->end_us;
+            return pos;
+        case ESP_MICROSLEEP_TRACE_RECORD_TASK:
+            if (!(used = esp_microsleep_trace_get_varint(in + pos, len - pos, &fields[0]))) { return len - pos >= 10 ? -1 : 0; }
+            pos += used;
+            if (pos >= len) { return 0; }
+            if (in[pos] > ESP_MICROSLEEP_TRACE_NAME_MAX) { return -1; }
+            if (pos + 1 + in[pos] > len) { return 0; }
+            record->task = (uint32_t) fields[0];
+            memcpy(record->name, in + pos + 1, in[pos]);
+            record->name[in[pos]] = 0;
+            return pos + 1 + in[pos];
+        case ESP_MICROSLEEP_TRACE_RECORD_DROPPED:
+            if (!(used = esp_microsleep_trace_get_varint(in + pos, len - pos, &record->dropped))) { return len - pos >= 10 ? -1 : 0; }
+            return pos + used;
+    }
+    return -1;
+}
+
+#endif // ESP_MICROSLEEP_TRACE_FORMAT_H
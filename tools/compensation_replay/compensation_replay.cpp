@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// Replays the wakeup latencies recorded in binary traces (see esp_microsleep_trace_start())
+// through the compensation policies of esp_microsleep_compensation.c and reports the
+// resulting wakeup error distribution per policy.
+//
+// Only delays served by a plain timer sleep carry the raw latency (elapsed - armed).
+// The replay assumes the latency does not depend on how early the timer is armed.
+//
+// Usage: compensation_replay [--percentile <p>] [--calibration <n>] [<trace file>|-]
+
+#include "esp_microsleep_compensation.h"
+#include "esp_microsleep_trace_format.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace {
+
+const uint8_t strategy_sleep = 0;  // ESP_MICROSLEEP_STRATEGY_SLEEP
+
+const struct {
+    esp_microsleep_compensation_policy_t policy;
+    const char* name;
+} policies[] = {
+    { ESP_MICROSLEEP_COMPENSATION_MEAN, "mean" },
+    { ESP_MICROSLEEP_COMPENSATION_PERCENTILE, "percentile" },
+    { ESP_MICROSLEEP_COMPENSATION_ADAPTIVE, "adaptive" },
+    { ESP_MICROSLEEP_COMPENSATION_DURATION, "duration" },
+};
+constexpr size_t policy_count = sizeof(policies) / sizeof(policies[0]);
+
+// Exact distribution of integer errors: dense around zero, sparse for outliers.
+class Distribution {
+public:
+    void add(int64_t value) {
+        ++count_;
+        sum_ += value;
+        abs_sum_ += value < 0 ? -value : value;
+        if (value < 0) { ++early_; }
+        if (value > 0) { ++late_; }
+        if (value >= -dense_range && value < dense_range) {
+            ++dense_[value + dense_range];
+        } else {
+            ++sparse_[value];
+        }
+    }
+
+    uint64_t count() const { return count_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0; }
+    double mean_abs() const { return count_ ? static_cast<double>(abs_sum_) / count_ : 0; }
+    double early_pct() const { return count_ ? 100.0 * early_ / count_ : 0; }
+    double late_pct() const { return count_ ? 100.0 * late_ / count_ : 0; }
+
+    int64_t quantile(double q) const {
+        if (!count_) { return 0; }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count_ + 0.999999));
+        uint64_t seen = 0;
+        auto it = sparse_.begin();
+        for (; it != sparse_.end() && it->first < -dense_range; ++it) {
+            if ((seen += it->second) >= rank) { return it->first; }
+        }
+        for (int64_t i = 0; i < 2 * dense_range; ++i) {
+            if ((seen += dense_[i]) >= rank) { return i - dense_range; }
+        }
+        for (; it != sparse_.end(); ++it) {
+            if ((seen += it->second) >= rank) { return it->first; }
+        }
+        return sparse_.empty() ? 0 : sparse_.rbegin()->first;
+    }
+
+private:
+    static constexpr int64_t dense_range = 4096;
+    std::vector<uint64_t> dense_ = std::vector<uint64_t>(2 * dense_range);
+    std::map<int64_t, uint64_t> sparse_;
+    uint64_t count_ = 0;
+    int64_t sum_ = 0;
+    int64_t abs_sum_ = 0;
+    uint64_t early_ = 0;
+    uint64_t late_ = 0;
+};
+
+struct Replay {
+    Distribution error;
+    uint64_t spun = 0;
+};
+
+// Per task and policy, like the per-task histories on the device.
+struct Task {
+    esp_microsleep_compensation_t state[policy_count];
+};
+
+int usage(const char* self) {
+    std::fprintf(stderr, "usage: %s [--percentile <p>] [--calibration <n>] [<trace file>|-]\n", self);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned percentile = 90;
+    unsigned calibration = 10;
+    const char* path = "-";
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--percentile") && i + 1 < argc) {
+            percentile = std::strtoul(argv[++i], nullptr, 10);
+            if (!percentile || percentile > 100) { return usage(argv[0]); }
+        } else if (!std::strcmp(argv[i], "--calibration") && i + 1 < argc) {
+            calibration = std::strtoul(argv[++i], nullptr, 10);
+            if (!calibration) { return usage(argv[0]); }
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            return usage(argv[0]);
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE* file = std::strcmp(path, "-") ? std::fopen(path, "rb") : stdin;
+    if (!file) {
+        std::perror(path);
+        return 1;
+    }
+
+    Replay replays[policy_count];
+    std::map<uint64_t, Task> tasks;
+    uint64_t streams = 0;
+    uint64_t records = 0;
+    uint64_t sleeps = 0;
+
+    // Like esp_microsleep_calibrate(), the mean policy uses the mean of the first latencies of a stream.
+    uint64_t calibration_sum = 0;
+    unsigned calibration_samples = 0;
+    uint32_t calibrated = 0;
+
+    std::vector<uint8_t> buffer(1 << 20);
+    size_t used = 0;
+    uint64_t last_end = 0;
+    bool in_stream = false;
+    esp_microsleep_trace_record_t record;
+
+    for (;;) {
+        const size_t got = std::fread(buffer.data() + used, 1, buffer.size() - used, file);
+        const bool eof = got == 0;
+        used += got;
+
+        size_t pos = 0;
+        while (pos < used) {
+            if (buffer[pos] == ESP_MICROSLEEP_TRACE_MAGIC[0]) {
+                if (used - pos < ESP_MICROSLEEP_TRACE_HEADER_LEN && !eof) { break; }
+                if (esp_microsleep_trace_check_header(&buffer[pos], used - pos)) {
+                    ++streams;
+                    in_stream = true;
+                    last_end = 0;
+                    calibration_sum = 0;
+                    calibration_samples = 0;
+                    calibrated = 0;
+                    pos += ESP_MICROSLEEP_TRACE_HEADER_LEN;
+                    continue;
+                }
+            }
+            if (!in_stream) {
+                std::fprintf(stderr, "%s: no trace header\n", path);
+                return 1;
+            }
+            const ptrdiff_t consumed = esp_microsleep_trace_decode(&buffer[pos], used - pos, &last_end, &record);
+            if (consumed < 0) {
+                std::fprintf(stderr, "%s: malformed record\n", path);
+                return 1;
+            }
+            if (consumed == 0) { break; }
+            pos += consumed;
+            ++records;
+            if (record.type != ESP_MICROSLEEP_TRACE_RECORD_DELAY || record.strategy != strategy_sleep || !record.armed_us) { continue; }
+
+            ++sleeps;
+            const uint32_t latency = record.elapsed_us > record.armed_us ? static_cast<uint32_t>(record.elapsed_us - record.armed_us) : 0;
+            if (calibration_samples < calibration) {
+                calibration_sum += latency;
+                calibrated = static_cast<uint32_t>(calibration_sum / ++calibration_samples);
+            }
+
+            const uint64_t key = (streams << 32) | record.task;
+            auto found = tasks.find(key);
+            if (found == tasks.end()) {
+                found = tasks.emplace(key, Task()).first;
+                for (auto& state : found->second.state) { esp_microsleep_compensation_init(&state, static_cast<uint8_t>(percentile)); }
+            }
+            for (size_t i = 0; i < policy_count; ++i) {
+                esp_microsleep_compensation_t& state = found->second.state[i];
+                const uint32_t compensation = esp_microsleep_compensation_get(&state, policies[i].policy, calibrated, record.requested_us);
+                if (record.requested_us <= compensation) {
+                    // esp_microsleep_delay() spins delays not exceeding the compensation.
+                    ++replays[i].spun;
+                    continue;
+                }
+                replays[i].error.add(static_cast<int64_t>(latency) - static_cast<int64_t>(compensation));
+                esp_microsleep_compensation_observe(&state, record.requested_us, latency);
+            }
+        }
+        std::memmove(buffer.data(), buffer.data() + pos, used - pos);
+        used -= pos;
+        if (eof) { break; }
+    }
+    if (file != stdin) { std::fclose(file); }
+
+    std::printf("streams %" PRIu64 ", records %" PRIu64 ", timer sleeps replayed %" PRIu64 ", tasks %zu\n\n", streams, records, sleeps, tasks.size());
+    std::printf("%-12s %10s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", "policy", "sleeps", "spun", "mean", "mean|e|", "p1", "p50", "p99", "p99.9", "early%", "late%");
+    for (size_t i = 0; i < policy_count; ++i) {
+        const Distribution& e = replays[i].error;
+        std::printf("%-12s %10" PRIu64 " %8" PRIu64 " %8.2f %8.2f %8" PRId64 " %8" PRId64 " %8" PRId64 " %8" PRId64 " %8.2f %8.2f\n", policies[i].name,
+                    e.count(), replays[i].spun, e.mean(), e.mean_abs(), e.quantile(0.01), e.quantile(0.5), e.quantile(0.99), e.quantile(0.999),
+                    e.early_pct(), e.late_pct());
+    }
+    std::printf("\nerror = actual - requested wakeup time in us, positive is late\n");
+    return 0;
+}
@@ -0,0 +1,11 @@
+// Host stand-in for the FreeRTOS header of the same name, only what the tested sources use.
+#pragma once
+#include <stdint.h>
+#include "sdkconfig.h"
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct { uint32_t owner; uint32_t count; } portMUX_TYPE;
+BaseType_t xPortInIsrContext(void);
+#define configMAX_TASK_NAME_LEN 16
+typedef struct { void* dummy[20]; } StaticSemaphore_t;
@@ -0,0 +1,6 @@
+// Host stand-in for the FreeRTOS header of the same name, only what the tested sources use.
+#pragma once
+#include "FreeRTOS.h"
+typedef struct QueueDefinition* QueueHandle_t;
+typedef struct QueueDefinition* QueueSetHandle_t;
+typedef struct QueueDefinition* QueueSetMemberHandle_t;
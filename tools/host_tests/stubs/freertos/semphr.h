@@ -0,0 +1,4 @@
+// Host stand-in for the FreeRTOS header of the same name, only what the tested sources use.
+#pragma once
+#include "queue.h"
+typedef QueueHandle_t SemaphoreHandle_t;
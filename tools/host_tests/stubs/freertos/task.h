@@ -0,0 +1,8 @@
+// Host stand-in for the FreeRTOS header of the same name, only what the tested sources use.
+#pragma once
+#include "FreeRTOS.h"
+typedef struct tskTaskControlBlock* TaskHandle_t;
+#define taskSCHEDULER_SUSPENDED 0
+#define taskSCHEDULER_NOT_STARTED 1
+#define taskSCHEDULER_RUNNING 2
+BaseType_t xTaskGetSchedulerState(void);
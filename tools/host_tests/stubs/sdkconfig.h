@@ -0,0 +1,8 @@
+// Minimal configuration for building the component sources on the host.
+#pragma once
+#define CONFIG_ESP_MICROSLEEP_TLS_INDEX 1
+#define CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD 1
+#define CONFIG_ESP_MICROSLEEP_WRAP_SLEEP 1
+#define CONFIG_ESP_MICROSLEEP_DOMAIN_NAME_LEN 16
+#define CONFIG_ESP_MICROSLEEP_DEADLINE_DEPTH 4
+#define CONFIG_ESP_MICROSLEEP_COMPENSATION_PERCENTILE 90
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// Checks the compensation policies of esp_microsleep_compensation.c.
+
+#include "esp_microsleep_compensation.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int compare_latency(const void* a, const void* b) {
+
+    return (int) *(const uint16_t*) a - (int) *(const uint16_t*) b;
+}
+
+// The percentile the policy should return, computed from scratch.
+static uint32_t reference_percentile(const uint16_t* latencies, size_t count, uint8_t percentile) {
+
+    const size_t window = count < ESP_MICROSLEEP_COMPENSATION_HISTORY ? count : ESP_MICROSLEEP_COMPENSATION_HISTORY;
+    uint16_t sorted[ESP_MICROSLEEP_COMPENSATION_HISTORY];
+    for (size_t i = 0; i < window; i++) { sorted[i] = latencies[count - window + i]; }
+    qsort(sorted, window, sizeof(sorted[0]), compare_latency);
+    return sorted[(window - 1) * percentile / 100];
+}
+
+int main(void) {
+
+    esp_microsleep_compensation_t state;
+
+    // Without history, every policy falls back to the calibrated latency.
+    esp_microsleep_compensation_init(&state, 90);
+    for (int policy = ESP_MICROSLEEP_COMPENSATION_MEAN; policy <= ESP_MICROSLEEP_COMPENSATION_DURATION; policy++) {
+        assert(esp_microsleep_compensation_get(&state, (esp_microsleep_compensation_policy_t) policy, 42, 1000) == 42);
+    }
+
+    esp_microsleep_compensation_init(&state, 0);
+    assert(state.percentile == 1);
+    esp_microsleep_compensation_init(&state, 200);
+    assert(state.percentile == 100);
+
+    // The percentile follows the sliding window, also once old latencies are evicted.
+    static const uint8_t percentiles[] = { 1, 50, 90, 100 };
+    for (size_t p = 0; p < sizeof(percentiles); p++) {
+        esp_microsleep_compensation_init(&state, percentiles[p]);
+        uint16_t latencies[10 * ESP_MICROSLEEP_COMPENSATION_HISTORY];
+        srand(p + 1);
+        for (size_t i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+            // Few distinct values, so that evicting one of several equal latencies is covered.
+            latencies[i] = (uint16_t)(20 + rand() % 16);
+            esp_microsleep_compensation_observe(&state, 500, latencies[i]);
+            assert(esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_PERCENTILE, 0, 500) == reference_percentile(latencies, i + 1, percentiles[p]));
+        }
+    }
+
+    // Latencies beyond the 16 bit history saturate.
+    esp_microsleep_compensation_init(&state, 100);
+    esp_microsleep_compensation_observe(&state, 500, 100000);
+    assert(esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_PERCENTILE, 0, 500) == UINT16_MAX);
+
+    // The mean policy ignores the history.
+    assert(esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_MEAN, 42, 500) == 42);
+
+    // The moving average converges to a steady latency and follows a change.
+    esp_microsleep_compensation_init(&state, 50);
+    for (int i = 0; i < 100; i++) { esp_microsleep_compensation_observe(&state, 500, 30); }
+    assert(esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_ADAPTIVE, 0, 500) == 30);
+    for (int i = 0; i < 100; i++) { esp_microsleep_compensation_observe(&state, 500, 60); }
+    const uint32_t adapted = esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_ADAPTIVE, 0, 500);
+    assert(adapted >= 58 && adapted <= 60);
+
+    // The duration fit needs a few samples, then predicts latency = 10 µs + 1% of the requested duration.
+    esp_microsleep_compensation_init(&state, 50);
+    static const uint64_t durations[] = { 200, 1000, 5000, 20000 };
+    for (int i = 0; i < 7; i++) { esp_microsleep_compensation_observe(&state, durations[i % 4], (uint32_t)(10 + durations[i % 4] / 100)); }
+    assert(esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_DURATION, 42, 1000) == 42);
+    for (int i = 7; i < 400; i++) { esp_microsleep_compensation_observe(&state, durations[i % 4], (uint32_t)(10 + durations[i % 4] / 100)); }
+    static const uint64_t probes[] = { 200, 3000, 10000, 20000 };
+    for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+        const int64_t expected = 10 + (int64_t) probes[i] / 100;
+        const int64_t fitted = esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_DURATION, 0, probes[i]);
+        assert(fitted >= expected - 2 && fitted <= expected + 2);
+    }
+
+    // Without variation in the duration, the fit degrades to the mean latency.
+    esp_microsleep_compensation_init(&state, 50);
+    for (int i = 0; i < 100; i++) { esp_microsleep_compensation_observe(&state, 1000, 25); }
+    assert(esp_microsleep_compensation_get(&state, ESP_MICROSLEEP_COMPENSATION_DURATION, 0, 50000) == 25);
+
+    printf("compensation: ok\n");
+    return 0;
+}
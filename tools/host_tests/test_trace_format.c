@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// Checks the varint/zigzag encoding of esp_microsleep_trace_format.h and that records survive a round trip.
+
+#include "esp_microsleep_trace_format.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static void check_varint(uint64_t value, size_t expected_len) {
+
+    uint8_t buf[10];
+    const size_t len = esp_microsleep_trace_put_varint(buf, value);
+    assert(len == expected_len);
+    uint64_t decoded = ~value;
+    assert(esp_microsleep_trace_get_varint(buf, len, &decoded) == len);
+    assert(decoded == value);
+    // One byte short is truncated, not a different value.
+    assert(esp_microsleep_trace_get_varint(buf, len - 1, &decoded) == 0);
+}
+
+static void check_zigzag(int64_t value, uint64_t expected) {
+
+    assert(esp_microsleep_trace_zigzag(value) == expected);
+    assert(esp_microsleep_trace_unzigzag(expected) == value);
+}
+
+int main(void) {
+
+    check_varint(0, 1);
+    check_varint(127, 1);
+    check_varint(128, 2);
+    check_varint(16383, 2);
+    check_varint(16384, 3);
+    check_varint(UINT32_MAX, 5);
+    check_varint(UINT64_MAX, 10);
+
+    check_zigzag(0, 0);
+    check_zigzag(-1, 1);
+    check_zigzag(1, 2);
+    check_zigzag(-2, 3);
+    check_zigzag(INT64_MAX, UINT64_MAX - 1);
+    check_zigzag(INT64_MIN, UINT64_MAX);
+
+    // More than 10 bytes with continuation bits is malformed.
+    uint8_t overlong[11];
+    memset(overlong, 0x80, sizeof(overlong));
+    uint64_t value;
+    assert(esp_microsleep_trace_get_varint(overlong, sizeof(overlong), &value) == 0);
+
+    const esp_microsleep_trace_record_t records[] = {
+        { .type = ESP_MICROSLEEP_TRACE_RECORD_TASK, .task = 1, .name = "control" },
+        { .type = ESP_MICROSLEEP_TRACE_RECORD_DELAY, .strategy = 1, .end_us = 1000000, .task = 1, .requested_us = 100, .armed_us = 70, .elapsed_us = 104 },
+        // Records of different tasks may arrive out of order, the delta is negative then.
+        { .type = ESP_MICROSLEEP_TRACE_RECORD_DELAY, .strategy = 2, .end_us = 999950, .task = 300, .requested_us = 5, .armed_us = 0, .elapsed_us = 5 },
+        { .type = ESP_MICROSLEEP_TRACE_RECORD_DROPPED, .dropped = 12345 },
+        { .type = ESP_MICROSLEEP_TRACE_RECORD_DELAY, .strategy = 0, .end_us = UINT64_MAX / 2, .task = 1, .requested_us = UINT64_MAX, .armed_us = 1, .elapsed_us = 0 },
+        { .type = ESP_MICROSLEEP_TRACE_RECORD_TASK, .task = 300, .name = "" },
+    };
+    const size_t count = sizeof(records) / sizeof(records[0]);
+
+    uint8_t stream[ESP_MICROSLEEP_TRACE_HEADER_LEN + sizeof(records) / sizeof(records[0]) * ESP_MICROSLEEP_TRACE_RECORD_MAX];
+    size_t len = esp_microsleep_trace_put_header(stream);
+    uint64_t last_end = 0;
+    for (size_t i = 0; i < count; i++) {
+        len += esp_microsleep_trace_encode(stream + len, &last_end, &records[i]);
+    }
+
+    assert(esp_microsleep_trace_check_header(stream, len));
+    assert(!esp_microsleep_trace_check_header(stream, ESP_MICROSLEEP_TRACE_HEADER_LEN - 1));
+
+    size_t pos = ESP_MICROSLEEP_TRACE_HEADER_LEN;
+    last_end = 0;
+    for (size_t i = 0; i < count; i++) {
+        // Every proper prefix of a record is reported as truncated.
+        const size_t start = pos;
+        uint64_t probe_end = last_end;
+        esp_microsleep_trace_record_t decoded;
+        ptrdiff_t used = esp_microsleep_trace_decode(stream + pos, len - pos, &probe_end, &decoded);
+        assert(used > 0);
+        for (size_t prefix = 0; prefix < (size_t) used; prefix++) {
+            uint64_t scratch_end = last_end;
+            esp_microsleep_trace_record_t scratch;
+            assert(esp_microsleep_trace_decode(stream + start, prefix, &scratch_end, &scratch) == 0);
+        }
+
+        memset(&decoded, 0, sizeof(decoded));
+        used = esp_microsleep_trace_decode(stream + pos, len - pos, &last_end, &decoded);
+        pos += used;
+        const esp_microsleep_trace_record_t* expected = &records[i];
+        assert(decoded.type == expected->type);
+        switch (expected->type) {
+            case ESP_MICROSLEEP_TRACE_RECORD_DELAY:
+                assert(decoded.strategy == expected->strategy);
+                assert(decoded.end_us == expected->end_us);
+                assert(decoded.task == expected->task);
+                assert(decoded.requested_us == expected->requested_us);
+                assert(decoded.armed_us == expected->armed_us);
+                assert(decoded.elapsed_us == expected->elapsed_us);
+                break;
+            case ESP_MICROSLEEP_TRACE_RECORD_TASK:
+                assert(decoded.task == expected->task);
+                assert(!strcmp(decoded.name, expected->name));
+                break;
+            case ESP_MICROSLEEP_TRACE_RECORD_DROPPED:
+                assert(decoded.dropped == expected->dropped);
+                break;
+        }
+    }
+    assert(pos == len);
+
+    // An unknown record type and an overlong name are malformed.
+    const uint8_t unknown[] = { 0x0f, 0x00 };
+    esp_microsleep_trace_record_t record;
+    assert(esp_microsleep_trace_decode(unknown, sizeof(unknown), &last_end, &record) == -1);
+    const uint8_t long_name[] = { ESP_MICROSLEEP_TRACE_RECORD_TASK, 0x01, ESP_MICROSLEEP_TRACE_NAME_MAX + 1 };
+    assert(esp_microsleep_trace_decode(long_name, sizeof(long_name), &last_end, &record) == -1);
+
+    // The trace task re-encodes records buffered without reference to the stream.
+    uint8_t item[ESP_MICROSLEEP_TRACE_RECORD_MAX];
+    uint64_t base = 0;
+    const size_t item_len = esp_microsleep_trace_encode(item, &base, &records[1]);
+    base = 0;
+    assert(esp_microsleep_trace_decode(item, item_len, &base, &record) == (ptrdiff_t) item_len);
+    assert(record.end_us == records[1].end_us);
+
+    printf("trace_format: ok\n");
+    return 0;
+}
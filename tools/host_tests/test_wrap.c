@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// Checks that usleep() and nanosleep() end up in the library when linked with --wrap.
+
+#include "esp_microsleep.h"
+#include "esp_microsleep_private.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+static int delays = 0;
+static uint64_t delayed_us = 0;
+static BaseType_t scheduler_state = taskSCHEDULER_RUNNING;
+
+esp_err_t esp_microsleep_delay_unscoped(uint64_t us) {
+
+    delays++;
+    delayed_us = us;
+    return ESP_OK;
+}
+
+BaseType_t xPortInIsrContext(void) {
+
+    return 0;
+}
+
+BaseType_t xTaskGetSchedulerState(void) {
+
+    return scheduler_state;
+}
+
+int main(void) {
+
+    assert(usleep(150) == 0);
+    assert(delays == 1 && delayed_us == 150);
+
+    // Rounded up, a shorter sleep is not allowed.
+    struct timespec rem = { .tv_sec = 7, .tv_nsec = 7 };
+    const struct timespec short_req = { .tv_sec = 0, .tv_nsec = 1500 };
+    assert(nanosleep(&short_req, &rem) == 0);
+    assert(delays == 2 && delayed_us == 2);
+    assert(rem.tv_sec == 0 && rem.tv_nsec == 0);
+
+    const struct timespec long_req = { .tv_sec = 2, .tv_nsec = 1000 };
+    assert(nanosleep(&long_req, NULL) == 0);
+    assert(delays == 3 && delayed_us == 2000001);
+
+    const struct timespec invalid = { .tv_sec = 0, .tv_nsec = 1000000000L };
+    errno = 0;
+    assert(nanosleep(&invalid, NULL) == -1 && errno == EINVAL);
+    assert(delays == 3);
+
+    // Without a running scheduler, the libc implementation is used.
+    scheduler_state = taskSCHEDULER_NOT_STARTED;
+    assert(usleep(1) == 0);
+    assert(nanosleep(&short_req, NULL) == 0);
+    assert(delays == 3);
+
+    printf("wrap: ok\n");
+    return 0;
+}
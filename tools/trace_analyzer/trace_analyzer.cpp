@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2024 Dr. Michael 'Mickey' Lauer <mlauer@vanille-media.de>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of itscontributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// Offline analysis of binary traces streamed by esp_microsleep_trace_start().
+//
+// Usage: trace_analyzer [--window <seconds>] [<trace file>|-]
+
+#include "esp_microsleep_trace_format.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const strategy_names[] = { "sleep", "hybrid", "spin" };
+
+// Log-linear histogram of signed microsecond values: exact below 64 µs,
+// 32 sub-buckets per power of two above, i.e. at most ~3 % error.
+class Histogram {
+public:
+    void add(int64_t value) {
+        ++count_;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        auto& buckets = value < 0 ? negative_ : positive_;
+        const size_t index = bucket(value < 0 ? -static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+        if (index >= buckets.size()) { buckets.resize(index + 1); }
+        ++buckets[index];
+    }
+
+    uint64_t count() const { return count_; }
+    int64_t min() const { return count_ ? min_ : 0; }
+    int64_t max() const { return count_ ? max_ : 0; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0; }
+
+    // Lower bound of the bucket containing the given quantile.
+    int64_t percentile(double q) const {
+        if (!count_) { return 0; }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * count_));
+        if (rank == 0) { rank = 1; }
+        uint64_t seen = 0;
+        for (size_t i = negative_.size(); i-- > 0;) {
+            seen += negative_[i];
+            if (seen >= rank) { return std::max(min_, -static_cast<int64_t>(upper(i))); }
+        }
+        for (size_t i = 0; i < positive_.size(); ++i) {
+            seen += positive_[i];
+            if (seen >= rank) { return std::min(max_, static_cast<int64_t>(lower(i))); }
+        }
+        return max_;
+    }
+
+    // Calls `fn(from, to, count)` for each non-empty bucket in ascending order.
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (size_t i = negative_.size(); i-- > 0;) {
+            if (negative_[i]) { fn(-static_cast<int64_t>(upper(i)), -static_cast<int64_t>(lower(i)), negative_[i]); }
+        }
+        for (size_t i = 0; i < positive_.size(); ++i) {
+            if (positive_[i]) { fn(static_cast<int64_t>(lower(i)), static_cast<int64_t>(upper(i)), positive_[i]); }
+        }
+    }
+
+private:
+    static constexpr unsigned sub_bits = 5;
+    static constexpr uint64_t linear = 2u << sub_bits;
+
+    static size_t bucket(uint64_t value) {
+        if (value < linear) { return value; }
+        const unsigned exponent = 63 - __builtin_clzll(value);
+        const unsigned shift = exponent - sub_bits;
+        return linear + (exponent - sub_bits - 1) * (1u << sub_bits) + ((value >> shift) & ((1u << sub_bits) - 1));
+    }
+    static uint64_t lower(size_t index) {
+        if (index < linear) { return index; }
+        const size_t offset = index - linear;
+        const unsigned exponent = offset / (1u << sub_bits) + sub_bits + 1;
+        const uint64_t sub = offset % (1u << sub_bits);
+        return (uint64_t(1) << exponent) + (sub << (exponent - sub_bits));
+    }
+    static uint64_t upper(size_t index) { return index < linear ? index : lower(index + 1) - 1; }
+
+    std::vector<uint64_t> positive_;
+    std::vector<uint64_t> negative_;
+    uint64_t count_ = 0;
+    int64_t sum_ = 0;
+    int64_t min_ = INT64_MAX;
+    int64_t max_ = INT64_MIN;
+};
+
+struct Task {
+    std::string name;
+    Histogram overshoot;
+    uint64_t requested_us = 0;
+    uint64_t armed_us = 0;
+    uint64_t elapsed_us = 0;
+};
+
+struct Window {
+    Histogram overshoot;
+};
+
+class Analyzer {
+public:
+    explicit Analyzer(uint64_t window_us) : window_us_(window_us) {}
+
+    void delay(const esp_microsleep_trace_record_t& record) {
+        const int64_t overshoot = static_cast<int64_t>(record.elapsed_us) - static_cast<int64_t>(record.requested_us);
+        overshoot_.add(overshoot);
+        if (record.strategy < strategies_.size()) { ++strategies_[record.strategy]; }
+
+        Task& task = tasks_[task_key(record.task)];
+        task.overshoot.add(overshoot);
+        task.requested_us += record.requested_us;
+        task.armed_us += record.armed_us;
+        task.elapsed_us += record.elapsed_us;
+
+        // Streams are laid out back to back on one timeline, the device might have rebooted in between.
+        if (!stream_first_us_) { stream_first_us_ = record.end_us; }
+        const uint64_t time_us = stream_offset_us_ + std::max(record.end_us, stream_first_us_) - stream_first_us_;
+        duration_us_ = std::max(duration_us_, time_us);
+        windows_[time_us / window_us_].overshoot.add(overshoot);
+
+        // Least squares fit of the overshoot over time, for the drift.
+        const double t = static_cast<double>(time_us) / 3.6e9;
+        fit_n_ += 1;
+        fit_t_ += t;
+        fit_tt_ += t * t;
+        fit_y_ += overshoot;
+        fit_ty_ += t * overshoot;
+    }
+
+    void task(const esp_microsleep_trace_record_t& record) { tasks_[task_key(record.task)].name = record.name; }
+    void dropped(uint64_t count) { dropped_ += count; }
+    void stream() {
+        ++streams_;
+        stream_offset_us_ = duration_us_;
+        stream_first_us_ = 0;
+    }
+
+    void report() const {
+        std::printf("streams:        %" PRIu64 "\n", streams_);
+        std::printf("delays:         %" PRIu64 " (%" PRIu64 " dropped)\n", overshoot_.count(), dropped_);
+        std::printf("duration:       %.3f s\n", duration_us_ / 1e6);
+        std::printf("strategies:     sleep %" PRIu64 ", hybrid %" PRIu64 ", spin %" PRIu64 "\n", strategies_[0], strategies_[1], strategies_[2]);
+        if (!overshoot_.count()) { return; }
+
+        std::printf("\novershoot (us): min %" PRId64 ", mean %.2f, p50 %" PRId64 ", p90 %" PRId64 ", p99 %" PRId64 ", p99.9 %" PRId64 ", max %" PRId64 "\n",
+                    overshoot_.min(), overshoot_.mean(), overshoot_.percentile(0.5), overshoot_.percentile(0.9),
+                    overshoot_.percentile(0.99), overshoot_.percentile(0.999), overshoot_.max());
+
+        std::printf("\nhistogram (us):\n");
+        uint64_t peak = 0;
+        overshoot_.for_each([&](int64_t, int64_t, uint64_t count) { peak = std::max(peak, count); });
+        overshoot_.for_each([&](int64_t from, int64_t to, uint64_t count) {
+            const int bar = static_cast<int>(50.0 * count / peak + 0.5);
+            std::printf("%8" PRId64 " .. %-8" PRId64 " %12" PRIu64 " %.*s\n", from, to, count, bar, "##################################################");
+        });
+
+        std::printf("\n%-20s %10s %8s %8s %8s %8s %12s %12s\n", "task", "delays", "mean", "p99", "max", "late%", "armed%", "armed ms");
+        for (const auto& [key, task] : tasks_) {
+            const Histogram& h = task.overshoot;
+            const std::string name = task.name.empty() ? "#" + std::to_string(key & 0xffffffff) : task.name;
+            std::printf("%-20s %10" PRIu64 " %8.2f %8" PRId64 " %8" PRId64 " %8.2f %12.1f %12.1f\n", name.c_str(), h.count(), h.mean(),
+                        h.percentile(0.99), h.max(), 100.0 * late(h) / std::max<uint64_t>(h.count(), 1),
+                        task.requested_us ? 100.0 * task.armed_us / task.requested_us : 0.0, task.armed_us / 1e3);
+        }
+
+        std::printf("\ndrift: %+.3f us/h (least squares fit of the overshoot)\n", drift());
+        std::printf("%10s %10s %8s %8s %8s\n", "window s", "delays", "mean", "p99", "max");
+        for (const auto& [index, window] : windows_) {
+            std::printf("%10.0f %10" PRIu64 " %8.2f %8" PRId64 " %8" PRId64 "\n", index * window_us_ / 1e6, window.overshoot.count(),
+                        window.overshoot.mean(), window.overshoot.percentile(0.99), window.overshoot.max());
+        }
+    }
+
+private:
+    // Task ids are only unique within a stream.
+    uint64_t task_key(uint32_t task) const { return (streams_ << 32) | task; }
+
+    static uint64_t late(const Histogram& h) {
+        uint64_t count = 0;
+        h.for_each([&](int64_t from, int64_t, uint64_t n) { if (from > 0) { count += n; } });
+        return count;
+    }
+
+    double drift() const {
+        const double denominator = fit_n_ * fit_tt_ - fit_t_ * fit_t_;
+        return denominator > 0 ? (fit_n_ * fit_ty_ - fit_t_ * fit_y_) / denominator : 0;
+    }
+
+    const uint64_t window_us_;
+    Histogram overshoot_;
+    std::vector<uint64_t> strategies_ = std::vector<uint64_t>(3);
+    std::map<uint64_t, Task> tasks_;
+    std::map<uint64_t, Window> windows_;
+    uint64_t dropped_ = 0;
+    uint64_t streams_ = 0;
+    uint64_t stream_first_us_ = 0;
+    uint64_t stream_offset_us_ = 0;
+    uint64_t duration_us_ = 0;
+    double fit_n_ = 0, fit_t_ = 0, fit_tt_ = 0, fit_y_ = 0, fit_ty_ = 0;
+};
+
+int usage(const char* self) {
+    std::fprintf(stderr, "usage: %s [--window <seconds>] [<trace file>|-]\n", self);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint64_t window_s = 60;
+    const char* path = "-";
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--window") && i + 1 < argc) {
+            window_s = std::strtoull(argv[++i], nullptr, 10);
+            if (!window_s) { return usage(argv[0]); }
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            return usage(argv[0]);
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE* file = std::strcmp(path, "-") ? std::fopen(path, "rb") : stdin;
+    if (!file) {
+        std::perror(path);
+        return 1;
+    }
+
+    Analyzer analyzer(window_s * 1000000);
+    std::vector<uint8_t> buffer(1 << 20);
+    size_t used = 0;
+    size_t offset = 0;       // of buffer[0] in the file
+    uint64_t last_end = 0;
+    bool in_stream = false;
+    esp_microsleep_trace_record_t record;
+
+    for (;;) {
+        const size_t got = std::fread(buffer.data() + used, 1, buffer.size() - used, file);
+        const bool eof = got == 0;
+        used += got;
+
+        size_t pos = 0;
+        while (pos < used) {
+            // A restarted trace begins a new stream with a new header, possibly concatenated.
+            if (buffer[pos] == ESP_MICROSLEEP_TRACE_MAGIC[0]) {
+                if (used - pos < ESP_MICROSLEEP_TRACE_HEADER_LEN && !eof) { break; }
+                if (esp_microsleep_trace_check_header(&buffer[pos], used - pos)) {
+                    analyzer.stream();
+                    in_stream = true;
+                    last_end = 0;
+                    pos += ESP_MICROSLEEP_TRACE_HEADER_LEN;
+                    continue;
+                }
+            }
+            if (!in_stream) {
+                std::fprintf(stderr, "%s: no trace header at offset %zu\n", path, offset + pos);
+                return 1;
+            }
+            const ptrdiff_t consumed = esp_microsleep_trace_decode(&buffer[pos], used - pos, &last_end, &record);
+            if (consumed < 0) {
+                std::fprintf(stderr, "%s: malformed record at offset %zu\n", path, offset + pos);
+                return 1;
+            }
+            if (consumed == 0) { break; }
+            pos += consumed;
+            switch (record.type) {
+                case ESP_MICROSLEEP_TRACE_RECORD_DELAY: analyzer.delay(record); break;
+                case ESP_MICROSLEEP_TRACE_RECORD_TASK: analyzer.task(record); break;
+                case ESP_MICROSLEEP_TRACE_RECORD_DROPPED: analyzer.dropped(record.dropped); break;
+            }
+        }
+        std::memmove(buffer.data(), buffer.data() + pos, used - pos);
+        used -= pos;
+        offset += pos;
+        if (eof) {
+            if (used) { std::fprintf(stderr, "%s: %zu bytes of truncated record at the end\n", path, used); }
+            break;
+        }
+    }
+    if (file != stdin) { std::fclose(file); }
+
+    analyzer.report();
+    return 0;
+}